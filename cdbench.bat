@@ -0,0 +1,22 @@
+@echo off
+rem Run CDBENCH with each driver and a couple of SHSUCDX configurations.
+rem MAKEFILE.LNX runs this in dosemu, in the directory with the images
+rem (made by MKBENCH); each line of RESULTS.TXT starts with the label.
+
+shsucdhd /f:bench.iso /q
+shsucdx /d:shsu-cdh /qq
+cdbench cdhd > results.txt
+shsucdx /u /qq
+shsucdx /d:shsu-cdh /b:8 /a:16 /n:40 /x /qq
+cdbench cdhd+bax >> results.txt
+shsucdx /u /qq
+shsucdhd /u /q
+
+shsudvhd /f:bench.ia /q
+shsucdx /d:shsu-dvh /qq
+cdbench dvhd >> results.txt
+shsucdx /u /qq
+shsucdx /d:shsu-dvh /b:8 /a:16 /n:40 /x /qq
+cdbench dvhd+bax >> results.txt
+shsucdx /u /qq
+shsudvhd /u /q
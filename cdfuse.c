@@ -0,0 +1,491 @@
+/*
+ * cdfuse.c: Mount a CD image with the names SHSUCDX would give it.
+ *
+ * A read-only FUSE file system for ISO 9660, High Sierra and Joliet images,
+ * using the directory library (ISODIR.C), so every name is the 8.3 name
+ * SHSUCDX shows for it: uppercased, truncated, with the same "~n" aliases
+ * when tildes are on (-~, SHSUCDX /~) and ISO names unless Joliet is wanted
+ * (-j, SHSUCDX with DOSLFN).  Lookups are converted the same way, so any
+ * case works, as does a long name that truncates to the 8.3 name.  "-l"
+ * lists the names in lowercase.
+ *
+ * The image is mapped, so the kernel's page cache holds its sectors and
+ * every thread reads them without locking.  Each directory is read once,
+ * the first time it's needed, into a table hashed by name; after that
+ * lookups don't read the image at all.  FUSE runs the requests in several
+ * threads (unless -s is given); only reading a new directory is serialised.
+ *
+ * As with SHSUCDX, if two names convert to the same 8.3 name only the first
+ * can be found (and only it is listed), unless tildes are on.
+ *
+ * Build with MAKEFILE.LNX (needs libfuse 3).
+ */
+
+#define PVERS "1.00"
+#define PDATE "17 October, 2026"
+
+#define FUSE_USE_VERSION 31
+#define _GNU_SOURCE
+#include <fuse.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include "isodir.h"
+
+#define A_RDONLY 0x01		// DOS attributes
+#define A_DIR	 0x10
+
+// A file or directory, as SHSUCDX sees it.
+struct node
+{
+  char		name[13];	// as listed ("NAME.EXT")
+  char		fcb[11];	// as looked up ("NAME    EXT")
+  int		attr;		// DOS attributes
+  unsigned long extent, size;
+  time_t	mtime;
+  struct dir*	dir;		// its entries, once read (directories only)
+  int		next;		// next node with the same hash (-1 for none)
+};
+
+// A directory's entries, hashed by FCB name.
+struct dir
+{
+  struct node*	node;
+  int		cnt;
+  int*		hash;		// first node of each chain (-1 for none)
+  unsigned	mask;		// size of hash - 1
+};
+
+struct iso_vol	vol;
+const unsigned char* image;
+unsigned long	image_sectors;
+struct node	root;
+pthread_mutex_t dir_lock = PTHREAD_MUTEX_INITIALIZER;
+int		lower;		// list names in lowercase
+
+
+// iso_read for the mapped image.
+const unsigned char* read_map( void* ctx, unsigned long sector )
+{
+  (void)ctx;
+  return (sector < image_sectors) ? image + (off_t)sector * ISO_SECTOR : NULL;
+}
+
+
+unsigned hash_fcb( const char* fcb )
+{
+  unsigned h = 2166136261u;	// FNV-1a
+  int i;
+
+  for (i = 0; i < 11; ++i)
+    h = (h ^ (unsigned char)fcb[i]) * 16777619u;
+  return h;
+}
+
+
+// Turn an FCB name into the displayed name, returning its length.
+int fcb_name( const char* fcb, char* name )
+{
+  char* p = name;
+  int	i;
+
+  for (i = 0; i < 8 && fcb[i] != ' '; ++i)
+    *p++ = fcb[i];
+  if (fcb[8] != ' ')
+  {
+    *p++ = '.';
+    for (i = 8; i < 11 && fcb[i] != ' '; ++i)
+      *p++ = fcb[i];
+  }
+  *p = '\0';
+  for (p = name; *p; ++p)
+  {
+    if (*p == '/')
+      *p = '_';
+    else if (lower && *p >= 'A' && *p <= 'Z')
+      *p += 'a' - 'A';
+  }
+  return p - name;
+}
+
+
+// The time of a record, as DOS would show it (i.e. local time).
+time_t rec_time( const struct iso_rec* r )
+{
+  struct tm tm;
+
+  if (r->date == NULL)
+    return 0;
+  memset( &tm, 0, sizeof(tm) );
+  tm.tm_year  = r->date[0];
+  tm.tm_mon   = r->date[1] - 1;
+  tm.tm_mday  = r->date[2];
+  tm.tm_hour  = r->date[3];
+  tm.tm_min   = r->date[4];
+  tm.tm_sec   = r->date[5];
+  tm.tm_isdst = -1;
+  return mktime( &tm );
+}
+
+
+// Read a directory into a hashed table.  Returns NULL if it could not be
+// read (or there's not enough memory).
+struct dir* load_dir( const struct node* n )
+{
+  struct iso_dir d;
+  struct iso_rec r;
+  struct dir*	 dir;
+  struct node*	 e;
+  char		 fcb[11];
+  int		 max = 0, rc, i;
+  unsigned	 h;
+
+  dir = calloc( 1, sizeof(*dir) );
+  if (dir == NULL)
+    return NULL;
+  memset( &r, 0, sizeof(r) );
+  r.flags  = ISO_DIR;
+  r.extent = n->extent;
+  r.size   = n->size;
+  IsoOpenDir( &vol, &d, &r );
+  while ((rc = IsoNext( &d, &r )) == 1)
+  {
+    if (r.len == 1 && r.name[0] <= 1)	// "." and ".."
+      continue;
+    IsoFCB( &vol, &r, fcb );
+    if (*fcb == ' ')
+      continue;
+    if (dir->cnt == max)
+    {
+      max = max ? max * 2 : 64;
+      e = realloc( dir->node, max * sizeof(*e) );
+      if (e == NULL)
+      {
+	rc = -1;
+	break;
+      }
+      dir->node = e;
+    }
+    e = &dir->node[dir->cnt++];
+    memcpy( e->fcb, fcb, 11 );
+    fcb_name( fcb, e->name );
+    e->attr   = IsoAttr( &r, 1 );
+    e->extent = r.extent;
+    e->size   = r.size;
+    e->mtime  = rec_time( &r );
+    e->dir    = NULL;
+  }
+  if (rc == 0)
+  {
+    for (dir->mask = 15; dir->mask < (unsigned)dir->cnt * 2; dir->mask <<= 1)
+      dir->mask |= 1;
+    dir->hash = malloc( (dir->mask + 1) * sizeof(int) );
+    if (dir->hash == NULL)
+      rc = -1;
+  }
+  if (rc != 0)
+  {
+    free( dir->node );
+    free( dir );
+    return NULL;
+  }
+
+  memset( dir->hash, -1, (dir->mask + 1) * sizeof(int) );
+  for (i = dir->cnt; --i >= 0;) 	// backwards, so the first is found
+  {
+    h = hash_fcb( dir->node[i].fcb ) & dir->mask;
+    dir->node[i].next = dir->hash[h];
+    dir->hash[h] = i;
+  }
+
+  return dir;
+}
+
+
+// Get the entries of a directory, reading it if this is the first time.
+struct dir* get_dir( struct node* n )
+{
+  struct dir* dir = __atomic_load_n( &n->dir, __ATOMIC_ACQUIRE );
+
+  if (dir == NULL)
+  {
+    pthread_mutex_lock( &dir_lock );
+    dir = n->dir;
+    if (dir == NULL)
+    {
+      dir = load_dir( n );
+      __atomic_store_n( &n->dir, dir, __ATOMIC_RELEASE );
+    }
+    pthread_mutex_unlock( &dir_lock );
+  }
+  return dir;
+}
+
+
+// Find the first entry with an FCB name, returning its index or -1.
+int find( const struct dir* dir, const char* fcb )
+{
+  int i;
+
+  for (i = dir->hash[hash_fcb( fcb ) & dir->mask]; i >= 0;
+       i = dir->node[i].next)
+    if (memcmp( dir->node[i].fcb, fcb, 11 ) == 0)
+      break;
+  return i;
+}
+
+
+// Find the node of a path, as SHSUCDX would.  Returns 0 or -errno.
+int lookup( const char* path, struct node** np )
+{
+  struct node* n = &root;
+  struct dir*  dir;
+  const char*  end;
+  char	       tmpl[11];
+  int	       i;
+
+  for (;;)
+  {
+    while (*path == '/')
+      ++path;
+    if (*path == '\0')
+      break;
+    if (!(n->attr & A_DIR))
+      return -ENOTDIR;
+    dir = get_dir( n );
+    if (dir == NULL)
+      return -EIO;
+    for (end = path; *end && *end != '/'; ++end) ;
+    IsoToFCB( path, end - path, 0, tmpl );
+    i = find( dir, tmpl );
+    if (i < 0)
+      return -ENOENT;
+    n = &dir->node[i];
+    path = end;
+  }
+
+  *np = n;
+  return 0;
+}
+
+
+void fill_stat( const struct node* n, struct stat* st )
+{
+  memset( st, 0, sizeof(*st) );
+  if (n->attr & A_DIR)
+  {
+    st->st_mode  = S_IFDIR | 0555;
+    st->st_nlink = 2;
+  }
+  else
+  {
+    st->st_mode  = S_IFREG | 0444;
+    st->st_nlink = 1;
+  }
+  st->st_uid	 = getuid();
+  st->st_gid	 = getgid();
+  st->st_size	 = n->size;
+  st->st_blksize = ISO_SECTOR;
+  st->st_blocks  = (n->size + 511) / 512;
+  st->st_atime	 = st->st_mtime = st->st_ctime = n->mtime;
+}
+
+
+void* cd_init( struct fuse_conn_info* conn, struct fuse_config* cfg )
+{
+  (void)conn;
+  // The image doesn't change, so the kernel can keep everything.
+  cfg->kernel_cache	= 1;
+  cfg->entry_timeout	= 3600;
+  cfg->negative_timeout = 3600;
+  cfg->attr_timeout	= 3600;
+  return NULL;
+}
+
+int cd_getattr( const char* path, struct stat* st, struct fuse_file_info* fi )
+{
+  struct node* n;
+  int rc;
+
+  (void)fi;
+  rc = lookup( path, &n );
+  if (rc == 0)
+    fill_stat( n, st );
+  return rc;
+}
+
+int cd_readdir( const char* path, void* buf, fuse_fill_dir_t filler,
+		off_t off, struct fuse_file_info* fi,
+		enum fuse_readdir_flags flags )
+{
+  struct node* n;
+  struct dir*  dir;
+  struct stat  st;
+  int	       rc, i;
+
+  (void)off; (void)fi; (void)flags;
+  rc = lookup( path, &n );
+  if (rc != 0)
+    return rc;
+  if (!(n->attr & A_DIR))
+    return -ENOTDIR;
+  dir = get_dir( n );
+  if (dir == NULL)
+    return -EIO;
+
+  filler( buf, ".", NULL, 0, 0 );
+  filler( buf, "..", NULL, 0, 0 );
+  for (i = 0; i < dir->cnt; ++i)
+  {
+    n = &dir->node[i];
+    if (find( dir, n->fcb ) != i)	// only list the name that's found
+      continue;
+    fill_stat( n, &st );
+    if (filler( buf, n->name, &st, 0, 0 ))
+      break;
+  }
+  return 0;
+}
+
+int cd_open( const char* path, struct fuse_file_info* fi )
+{
+  struct node* n;
+  int rc;
+
+  rc = lookup( path, &n );
+  if (rc != 0)
+    return rc;
+  if (n->attr & A_DIR)
+    return -EISDIR;
+  if ((fi->flags & O_ACCMODE) != O_RDONLY)
+    return -EROFS;
+  fi->fh = (uintptr_t)n;
+  fi->keep_cache = 1;
+  return 0;
+}
+
+int cd_read( const char* path, char* buf, size_t size, off_t off,
+	     struct fuse_file_info* fi )
+{
+  const struct node* n = (const struct node*)(uintptr_t)fi->fh;
+  off_t start;
+
+  (void)path;
+  if (off >= (off_t)n->size)
+    return 0;
+  if (size > n->size - off)
+    size = n->size - off;
+  start = (off_t)n->extent * ISO_SECTOR + off;
+  if (start + (off_t)size > (off_t)image_sectors * ISO_SECTOR)
+    return -EIO;		// truncated image
+  memcpy( buf, image + start, size );
+  return size;
+}
+
+int cd_statfs( const char* path, struct statvfs* st )
+{
+  (void)path;
+  memset( st, 0, sizeof(*st) );
+  st->f_bsize	= ISO_SECTOR;
+  st->f_frsize	= ISO_SECTOR;
+  st->f_blocks	= vol.size;
+  st->f_namemax = 12;
+  st->f_flag	= ST_RDONLY;
+  return 0;
+}
+
+const struct fuse_operations cd_ops =
+{
+  .init    = cd_init,
+  .getattr = cd_getattr,
+  .readdir = cd_readdir,
+  .open    = cd_open,
+  .read    = cd_read,
+  .statfs  = cd_statfs,
+};
+
+
+void usage( void )
+{
+  puts(
+"CDFUSE - mount a CD image with the names SHSUCDX would give it.\n"
+"Version " PVERS " (" PDATE "). Freeware.\n"
+"http://shsucdx.adoxa.vze.com/\n"
+"\n"
+"Mount a CD image with the names SHSUCDX would give it.\n"
+"\n"
+"cdfuse [-j] [-l] [-~] image mountpoint [FUSE options]\n"
+"\n"
+"  -j\tuse the Joliet names (as SHSUCDX does with DOSLFN)\n"
+"  -l\tlist the names in lowercase\n"
+"  -~\tadd tildes to long names (SHSUCDX /~)"
+  );
+}
+
+
+int main( int argc, char* argv[] )
+{
+  struct stat st;
+  const char* name;
+  int	fd, i, joliet = 0, tildes = 0;
+  off_t size;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; ++i)
+  {
+    switch (argv[i][1])
+    {
+      case 'j': joliet = 1; break;
+      case 'l': lower  = 1; break;
+      case '~': tildes = 1; break;
+      case '?':
+      case 'h':
+      case '-':
+	usage();
+	return 0;
+      default:
+	fprintf( stderr, "ERROR: unknown option: %s.\n", argv[i] );
+	return 1;
+    }
+  }
+  if (argc - i < 2)
+  {
+    usage();
+    return 1;
+  }
+
+  name = argv[i];
+  fd = open( name, O_RDONLY );
+  if (fd < 0 || fstat( fd, &st ) != 0)
+  {
+    fprintf( stderr, "ERROR: unable to open \"%s\".\n", name );
+    return 2;
+  }
+  size = lseek( fd, 0, SEEK_END );	// also works for a device
+  image_sectors = size / ISO_SECTOR;
+  image = (image_sectors <= 16) ? MAP_FAILED
+	  : mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+  if (image == MAP_FAILED ||
+      IsoOpen( &vol, read_map, NULL, joliet ) == ISO_NONE)
+  {
+    fprintf( stderr, "ERROR: \"%s\" is not a CD image.\n", name );
+    return 3;
+  }
+  vol.tildes = tildes;
+
+  root.attr   = A_DIR;
+  root.extent = vol.root;
+  root.size   = vol.root_size;
+  root.mtime  = st.st_mtime;
+
+  // The rest of the arguments (the mount point first) are for FUSE.
+  argv[i] = argv[0];
+  return fuse_main( argc - i, argv + i, &cd_ops, NULL );
+}
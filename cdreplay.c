@@ -0,0 +1,514 @@
+/*
+ * cdreplay.c: Replay a SHSUCDX trace against an image.
+ *
+ * SHSUCDX assembled with TRACE records each redirector request and each
+ * device read in a ring, which CDTEST /T writes to a file.  This reads that
+ * file and an image of the same CD, then performs the device reads again,
+ * timing each one and crediting it to the request that caused it.  The
+ * directory library (ISODIR.C) maps every sector to its file or directory,
+ * so the report shows how much of the reading was directories (what the
+ * directory cache and index save) and how often a sector had to be read
+ * again (what the sector buffers save).  "-c sectors" also shows what a
+ * cache of that many sectors in front of the device would have saved.
+ *
+ * Build with MAKEFILE.LNX.
+ */
+
+#define PVERS "1.00"
+#define PDATE "17 October, 2026"
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "isodir.h"
+
+#define READLONG 0x80		// device ReadLong (rhcmdReadLong)
+#define MAXREAD  64		// sectors in a single read (64Ki / 2048, +)
+#define MOUNT	 16		// first sector read to mount the CD
+
+// A trace entry, as written by CDTEST.
+struct req
+{
+  unsigned char func;
+  unsigned char drive;
+  unsigned	count;		// bytes (client's CX) or sectors
+  unsigned long sector;
+};
+
+// An extent of the image belonging to a file or directory.
+struct extent
+{
+  unsigned long start, len;	// in sectors
+  int		dir;
+  char* 	name;
+};
+
+// Totals for a redirector function.
+struct op
+{
+  unsigned long calls;
+  unsigned long reads;		// device requests
+  unsigned long sectors;
+  unsigned long dir, file, other; // sectors by type
+  unsigned long again;		// sectors read before
+  double	secs;		// time spent reading (fastest run)
+};
+
+struct op ops[256];
+
+struct extent* ext;
+unsigned       ext_cnt, ext_max;
+
+unsigned char* seen;		// sectors read so far (one bit each)
+unsigned long  vol_size;
+
+unsigned long* lru;		// simulated cache (-c), most recent first
+unsigned       lru_cnt, lru_max;
+unsigned long  lru_hits;
+
+int list;			// -l: list each request
+
+
+void add_extent( unsigned long start, unsigned long bytes, int dir,
+		 const char* name )
+{
+  if (bytes == 0)
+    return;
+  if (ext_cnt == ext_max)
+  {
+    ext_max = ext_max ? ext_max * 2 : 1024;
+    ext = realloc( ext, ext_max * sizeof(*ext) );
+    if (ext == NULL)
+    {
+      fputs( "ERROR: not enough memory.\n", stderr );
+      exit( 2 );
+    }
+  }
+  ext[ext_cnt].start = start;
+  ext[ext_cnt].len   = (bytes + ISO_SECTOR - 1) / ISO_SECTOR;
+  ext[ext_cnt].dir   = dir;
+  ext[ext_cnt].name  = strdup( name );
+  ++ext_cnt;
+}
+
+
+int cmp_extent( const void* a, const void* b )
+{
+  const struct extent* x = a;
+  const struct extent* y = b;
+
+  return (x->start < y->start) ? -1 : (x->start > y->start);
+}
+
+
+// Find the extent containing sector, or NULL if it's not part of any.
+struct extent* find_extent( unsigned long sector )
+{
+  unsigned lo = 0, hi = ext_cnt, mid;
+
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if (sector < ext[mid].start)
+      hi = mid;
+    else if (sector >= ext[mid].start + ext[mid].len)
+      lo = mid + 1;
+    else
+      return &ext[mid];
+  }
+  return NULL;
+}
+
+
+// Append an FCB name to path, as DOS would display it.
+void add_name( char* path, const char* fcb )
+{
+  char* p = path + strlen( path );
+  int	i;
+
+  *p++ = '\\';
+  for (i = 0; i < 8 && fcb[i] != ' '; ++i)
+    *p++ = fcb[i];
+  if (fcb[8] != ' ')
+  {
+    *p++ = '.';
+    for (i = 8; i < 11 && fcb[i] != ' '; ++i)
+      *p++ = fcb[i];
+  }
+  *p = '\0';
+}
+
+
+// Map the directories (from the path table) and the files in them.
+int map_image( struct iso_vol* v )
+{
+  struct iso_path p;
+  struct iso_pent e;
+  struct iso_dir  d;
+  struct iso_rec  r;
+  char**   paths = NULL;
+  unsigned cnt = 0;
+  char	   fcb[11], name[1024];
+  unsigned long size;
+
+  v->tildes = 1;		// keep long names apart (SHSUCDX /~)
+  if (!IsoOpenPath( v, &p ))
+    return 0;
+  while (IsoNextPath( &p, &e ))
+  {
+    paths = realloc( paths, (cnt + 1) * sizeof(*paths) );
+    if (paths == NULL)
+      return 0;
+    if (e.num == 1 || e.parent == 0 || e.parent > cnt)
+      *name = '\0';
+    else
+    {
+      memset( &r, 0, sizeof(r) );
+      r.name = e.name;
+      r.len  = e.len;
+      r.ucs2 = e.ucs2;
+      IsoFCB( v, &r, fcb );
+      strcpy( name, paths[e.parent-1] );
+      if (strlen( name ) + 14 <= sizeof(name))
+	add_name( name, fcb );
+    }
+    paths[cnt++] = strdup( name );
+
+    // The directory's size is in its "." record.
+    memset( &r, 0, sizeof(r) );
+    r.flags  = ISO_DIR;
+    r.extent = e.extent;
+    r.size   = ISO_SECTOR;
+    IsoOpenDir( v, &d, &r );
+    if (IsoNext( &d, &r ) != 1)
+      continue;
+    size = r.size;
+    add_extent( e.extent, size, 1, (*name) ? name : "\\" );
+
+    r.extent = e.extent;
+    r.size   = size;
+    r.flags  = ISO_DIR;
+    IsoOpenDir( v, &d, &r );
+    while (IsoNext( &d, &r ) == 1)
+    {
+      if ((r.flags & ISO_DIR) || (r.len == 1 && r.name[0] <= 1))
+	continue;
+      if (strlen( name ) + 14 > sizeof(name))
+	continue;
+      IsoFCB( v, &r, fcb );
+      strcpy( name, paths[cnt-1] );
+      add_name( name, fcb );
+      add_extent( r.extent, r.size, 0, name );
+      strcpy( name, paths[cnt-1] );
+    }
+  }
+  IsoClosePath( &p );
+  while (cnt)
+    free( paths[--cnt] );
+  free( paths );
+
+  qsort( ext, ext_cnt, sizeof(*ext), cmp_extent );
+  return 1;
+}
+
+
+// Simulate the cache for a sector; returns 1 if it was there.
+int lru_use( unsigned long sector )
+{
+  unsigned i;
+
+  for (i = 0; i < lru_cnt; ++i)
+    if (lru[i] == sector)
+      break;
+  if (i == lru_cnt)
+  {
+    if (lru_cnt < lru_max)
+      ++lru_cnt;
+    i = lru_cnt - 1;
+    memmove( lru + 1, lru, i * sizeof(*lru) );
+    lru[0] = sector;
+    return 0;
+  }
+  memmove( lru + 1, lru, i * sizeof(*lru) );
+  lru[0] = sector;
+  return 1;
+}
+
+
+double now( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// Perform a device read, returning the time it took.  If op is not NULL,
+// credit the sectors to it.
+double replay_read( int fd, const struct req* q, struct op* op )
+{
+  static unsigned char buf[MAXREAD * ISO_SECTOR];
+  struct extent* x;
+  unsigned long	 s;
+  unsigned	 cnt = q->count;
+  double	 t;
+
+  if (cnt > MAXREAD)
+    cnt = MAXREAD;
+  t = now();
+  if (pread( fd, buf, (size_t)cnt * ISO_SECTOR,
+	     (off_t)q->sector * ISO_SECTOR ) < 0)
+    perror( "read" );
+  t = now() - t;
+  if (op == NULL)
+    return t;
+
+  ++op->reads;
+  op->sectors += cnt;
+  for (s = q->sector; s < q->sector + cnt; ++s)
+  {
+    x = find_extent( s );
+    if (x == NULL)
+      ++op->other;
+    else if (x->dir)
+      ++op->dir;
+    else
+      ++op->file;
+    if (s < vol_size)
+    {
+      if (seen[s / 8] & (1 << (s % 8)))
+	++op->again;
+      seen[s / 8] |= 1 << (s % 8);
+    }
+    if (lru_max)
+      lru_hits += lru_use( s );
+  }
+  if (list)
+  {
+    x = find_extent( q->sector );
+    printf( "    read %8lu +%-3u %s\n", q->sector, q->count,
+	    (x == NULL) ? "" : x->name );
+  }
+  return t;
+}
+
+
+void usage( void )
+{
+  puts(
+"CDREPLAY - replay a SHSUCDX trace against an image.\n"
+"Version " PVERS " (" PDATE "). Freeware.\n"
+"http://shsucdx.adoxa.vze.com/\n"
+"\n"
+"Replay a SHSUCDX trace (from CDTEST /T) against an image of the CD.\n"
+"\n"
+"cdreplay [-c sectors] [-r repeat] [-l] trace image\n"
+"\n"
+"  -c\tshow what a cache of this many sectors would save\n"
+"  -r\treplay this many times, keeping the fastest time of each request\n"
+"  -l\tlist each request, with the files read"
+  );
+}
+
+
+int main( int argc, char* argv[] )
+{
+  static const char* names[256] = {
+    [0x05] = "ChDir",	  [0x06] = "Close",	[0x08] = "Read",
+    [0x0c] = "GetSpace",  [0x0f] = "GetAttr",	[0x16] = "Open",
+    [0x1b] = "FindFirst", [0x1c] = "FindNext",	[0x21] = "Seek",
+    [0x2e] = "EOpen",	  [READLONG] = "(mount)"
+  };
+  struct iso_file f;
+  struct iso_vol  v;
+  struct req*	  reqs = NULL;
+  unsigned	  cnt = 0, max = 0, i;
+  unsigned char   ent[8];
+  const char*	  tracefile = NULL;
+  const char*	  image = NULL;
+  FILE* 	  t;
+  int		  fd, repeat = 1, run, func, opt;
+  double	  *secs, *best;
+  struct op	  total;
+  struct extent*  x;
+
+  for (i = 1; i < (unsigned)argc; ++i)
+  {
+    if (*argv[i] == '-' && argv[i][1] != '\0')
+    {
+      switch (argv[i][1])
+      {
+	case 'c':
+	case 'r':
+	  opt  = argv[i][1];
+	  func = strtoul( (argv[i][2] == '\0' && argv[i+1] != NULL)
+			  ? argv[++i] : argv[i] + 2, NULL, 0 );
+	  if (opt == 'c')
+	    lru_max = func;
+	  else
+	    repeat = (func < 1) ? 1 : func;
+	  break;
+	case 'l':
+	  list = 1;
+	  break;
+	case '?':
+	case '-':
+	  usage();
+	  return 0;
+	default:
+	  fprintf( stderr, "ERROR: unknown option: %s.\n", argv[i] );
+	  return 1;
+      }
+    }
+    else if (tracefile == NULL)
+      tracefile = argv[i];
+    else
+      image = argv[i];
+  }
+  if (image == NULL)
+  {
+    usage();
+    return 1;
+  }
+
+  t = fopen( tracefile, "rb" );
+  if (t == NULL)
+  {
+    fprintf( stderr, "ERROR: unable to open \"%s\".\n", tracefile );
+    return 3;
+  }
+  while (fread( ent, 8, 1, t ) == 1)
+  {
+    if (cnt == max)
+    {
+      max = max ? max * 2 : 512;
+      reqs = realloc( reqs, max * sizeof(*reqs) );
+      if (reqs == NULL)
+      {
+	fputs( "ERROR: not enough memory.\n", stderr );
+	return 2;
+      }
+    }
+    reqs[cnt].func   = ent[0];
+    reqs[cnt].drive  = ent[1];
+    reqs[cnt].count  = ent[2] | (ent[3] << 8);
+    reqs[cnt].sector = ent[4] | (ent[5] << 8) | ((unsigned long)ent[6] << 16)
+		       | ((unsigned long)ent[7] << 24);
+    ++cnt;
+  }
+  fclose( t );
+
+  f.f = fopen( image, "rb" );
+  fd  = (f.f == NULL) ? -1 : open( image, O_RDONLY );
+  if (fd < 0)
+  {
+    fprintf( stderr, "ERROR: unable to open \"%s\".\n", image );
+    return 3;
+  }
+  if (IsoOpen( &v, IsoReadFile, &f, 1 ) == ISO_NONE || !map_image( &v ))
+  {
+    fprintf( stderr, "ERROR: \"%s\" is not a CD image.\n", image );
+    return 3;
+  }
+  vol_size = v.size;
+  seen = calloc( vol_size / 8 + 1, 1 );
+  lru  = malloc( (lru_max + 1) * sizeof(*lru) );
+  secs = malloc( (cnt + 1) * sizeof(*secs) );
+  best = malloc( (cnt + 1) * sizeof(*best) );
+  if (seen == NULL || lru == NULL || secs == NULL || best == NULL)
+  {
+    fputs( "ERROR: not enough memory.\n", stderr );
+    return 2;
+  }
+
+  // Each run times every request; the fastest time of each is kept, so
+  // repeating discards disturbances (the first run also reads the image
+  // into the host's cache, like SMARTDrive would for the CD).  Reads come
+  // after their request, except those made to mount the CD, which come
+  // before it (the request is only recorded once it's known to be for the
+  // CD).  Mounting starts by reading sector 16, the volume descriptors, so
+  // from that read to the next request (and before the first) the reads
+  // are credited to "(mount)", not to the request before.
+  for (run = 0; run < repeat; ++run)
+  {
+    unsigned cur = cnt;
+
+    for (i = 0; i <= cnt; ++i)
+      secs[i] = 0;
+    for (i = 0; i < cnt; ++i)
+    {
+      func = reqs[i].func;
+      if (func != READLONG)
+      {
+	cur = i;
+	if (run == 0)
+	{
+	  ++ops[func].calls;
+	  if (list)
+	  {
+	    printf( "%c: %-9s", 'A' + reqs[i].drive,
+		    (names[func]) ? names[func] : "?" );
+	    if (func == 0x08)
+	    {
+	      x = find_extent( reqs[i].sector );
+	      printf( " %5u bytes at %lu %s", reqs[i].count, reqs[i].sector,
+		      (x == NULL) ? "" : x->name );
+	    }
+	    putchar( '\n' );
+	  }
+	}
+	continue;
+      }
+      if (reqs[i].sector == MOUNT)
+	cur = cnt;
+      secs[cur] += replay_read( fd, &reqs[i], (run != 0) ? NULL
+				: &ops[(cur == cnt) ? READLONG : reqs[cur].func] );
+    }
+    for (i = 0; i <= cnt; ++i)
+      if (run == 0 || secs[i] < best[i])
+	best[i] = secs[i];
+  }
+
+  printf( "%-10s %7s %7s %8s %8s %8s %8s %8s %10s %9s\n",
+	  "Request", "Calls", "Reads", "Sectors", "Dir", "File", "Other",
+	  "Again", "Time (ms)", "Per call" );
+  memset( &total, 0, sizeof(total) );
+  for (func = 0; func < 256; ++func)
+  {
+    struct op* op = &ops[func];
+    if (op->calls == 0 && op->reads == 0)
+      continue;
+    op->secs = (func == READLONG) ? best[cnt] : 0;
+    for (i = 0; i < cnt; ++i)
+      if (reqs[i].func == func)
+	op->secs += best[i];
+    printf( "%-10s %7lu %7lu %8lu %8lu %8lu %8lu %8lu %10.3f %7.0fus\n",
+	    (names[func]) ? names[func] : "?",
+	    op->calls, op->reads, op->sectors, op->dir, op->file, op->other,
+	    op->again, op->secs * 1e3,
+	    (op->calls) ? op->secs * 1e6 / op->calls : 0.0 );
+    total.calls   += op->calls;
+    total.reads   += op->reads;
+    total.sectors += op->sectors;
+    total.dir	  += op->dir;
+    total.file	  += op->file;
+    total.other   += op->other;
+    total.again   += op->again;
+    total.secs	  += op->secs;
+  }
+  printf( "%-10s %7lu %7lu %8lu %8lu %8lu %8lu %8lu %10.3f\n", "Total",
+	  total.calls, total.reads, total.sectors, total.dir, total.file,
+	  total.other, total.again, total.secs * 1e3 );
+
+  if (lru_max && total.sectors)
+    printf( "\nA cache of %u sectors would have saved %lu of the %lu sectors "
+	    "(%.1f%%).\n", lru_max, lru_hits, total.sectors,
+	    lru_hits * 100.0 / total.sectors );
+
+  return 0;
+}
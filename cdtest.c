@@ -31,6 +31,10 @@
     use four characters for the options flag;
     initialise buffers "manually" to make binary smaller;
     added dump function.
+
+  17 October, 2026:
+    display the performance counters (/S), optionally resetting them (/Z);
+    write the trace to a file (/T).
 */
 
 #include <stdio.h>
@@ -66,12 +70,15 @@ int install_check( void )
 	       " %d bytes each entry.\n",
 	      regs.r_cx, regs.r_es, regs.r_di, regs.r_dx );
       printf( "Compiled with: %s, CD root form%s, High Sierra %ssupported,\n"
-	      "(%04X)         Joliet %ssupported, image on CD %ssupported.\n\n",
+	      "(%04X)         Joliet %ssupported, image on CD %ssupported,\n"
+	      "               directory index %ssupported, trace %srecorded.\n\n",
 	      (regs.r_bx &  1) ? "8086" : "386",
 	      (regs.r_bx &  2) ? "" : " not used",
 	      (regs.r_bx &  4) ? "" : "not ", regs.r_bx,
 	      (regs.r_bx &  8) ? "" : "not ",
-	      (regs.r_bx & 16) ? "" : "not " );
+	      (regs.r_bx & 16) ? "" : "not ",
+	      (regs.r_bx & 32) ? "" : "not ",
+	      (regs.r_bx & 64) ? "" : "not " );
       return 1;
     }
   }
@@ -81,6 +88,88 @@ int install_check( void )
 }
 
 
+// Display the performance counters (Int2F/AX=1100, BX=BABF), resetting them
+// afterwards if requested.
+void stats( int reset )
+{
+  static char* name[] = {
+    "Device requests",
+    "Sectors read",
+    "Sector buffer hits",
+    "Sector buffer misses",
+    "Directory cache hits",
+    "Directory cache misses",
+    "Directory sectors searched",
+    "Media checks"
+  };
+  unsigned long far* count;
+  int k;
+
+  regs.r_ax = 0x1100;
+  regs.r_bx = 0xBABF;
+  intr( 0x2f, &regs );
+  if (regs.r_bx == 0xBABF)
+  {
+    puts( "SHSUCDX performance counters are not available." );
+    return;
+  }
+  count = (unsigned long far*)MK_FP( regs.r_es, regs.r_di );
+  for (k = 0; k < regs.r_cx; ++k)
+  {
+    printf( "%-27s%10lu\n",
+	    (k < sizeof(name) / sizeof(*name)) ? name[k] : "?", count[k] );
+    if (reset)
+      count[k] = 0;
+  }
+  if (reset)
+    puts( "\nCounters reset." );
+}
+
+
+// Write the trace (Int2F/AX=1100, BX=BAC0) to a file, oldest request first,
+// then clear it. Each request is eight bytes: function (redirector, or 80
+// for a device ReadLong), drive, count (word) and sector (dword).
+void trace( char* name )
+{
+  unsigned char far* ring;
+  unsigned char ent[8];
+  unsigned n, next, k, written;
+  FILE* f;
+
+  regs.r_ax = 0x1100;
+  regs.r_bx = 0xBAC0;
+  intr( 0x2f, &regs );
+  if (regs.r_bx == 0xBAC0)
+  {
+    puts( "SHSUCDX is not recording a trace." );
+    return;
+  }
+  ring = (unsigned char far*)MK_FP( regs.r_es, regs.r_di );
+  n    = regs.r_cx;
+  next = regs.r_dx;
+
+  f = fopen( name, "wb" );
+  if (f == NULL)
+  {
+    printf( "Unable to create \"%s\".\n", name );
+    return;
+  }
+  written = 0;
+  for (k = 0; k < n; ++k)
+  {
+    _fmemcpy( ent, ring + (next + k) % n * 8, 8 );
+    if (ent[0] != 0)		// not used yet
+    {
+      fwrite( ent, 8, 1, f );
+      ++written;
+    }
+  }
+  fclose( f );
+  _fmemset( ring, 0, n * 8 );
+  printf( "%u request(s) written to \"%s\".\n", written, name );
+}
+
+
 // Display a hex and character dump.
 void dump( char* buf, int len )
 {
@@ -453,10 +542,28 @@ int main( int argc, char* argv[] )
 "specify a filename (complete path, including drive).\n"
 "Since results differ according to CD, manual verification is necessary.\n"
 "\n"
+"/S displays the performance counters; /Z displays and then resets them.\n"
+"/T file writes (and clears) the trace, if SHSUCDX is recording one.\n"
+"\n"
 "Jason Hood <jadoxa@yahoo.com.au>, 5 May, 2005."
       );
       return 0;
     }
+    if (argv[1][0] == '/' && ((argv[1][1] | 0x20) == 's' ||
+			      (argv[1][1] | 0x20) == 'z'))
+    {
+      if (install_check())
+	stats( (argv[1][1] | 0x20) == 'z' );
+      return 0;
+    }
+    if (argv[1][0] == '/' && (argv[1][1] | 0x20) == 't')
+    {
+      if (argc < 3)
+	puts( "Expecting a file name for the trace." );
+      else if (install_check())
+	trace( argv[2] );
+      return 0;
+    }
     dir_ent( argv[1] );
   }
   else if (install_check())
@@ -0,0 +1,563 @@
+/*
+ * dvdimg.c: Read and convert a split DVD image (SHSUDVHD's .I? files).
+ *
+ * SHSUDVHD takes the file from the top bits of the sector (sector >> 18)
+ * and reads the rest from it, relying on the 60Ki overlap for a read that
+ * starts near the end; DvdSectors does the same.  The files are mapped
+ * whole, so the page cache holds what's been read and nothing is copied
+ * (other than by DvdRead, which wants a buffer).
+ *
+ * Joining copies the first 512MiB of each file (the last one entirely),
+ * leaving out the overlaps.  Splitting an image file copies each range
+ * (512MiB plus the overlap) straight from the image, with XferCopy.  Any
+ * other source (a pipe or a device) can only be read forwards, so its
+ * sectors are written to the new file and, whilst the overlap lasts, to
+ * the end of the previous file as well.  A pipe is read until it ends; a
+ * device for as many sectors as its volume descriptor says.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dvdimg.h"
+#include "xfer.h"
+
+#define ISO_ID	"CD001"
+#define HSF_ID	"CDROM"
+
+
+static unsigned long get32( const unsigned char* p )
+{
+  return p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16)
+	 | ((unsigned long)p[3] << 24);
+}
+
+
+// Read up to len bytes (less only at the end).  Returns the number read, or
+// -1 for an error.
+static long long read_all( int fd, unsigned char* buf, long long len )
+{
+  long long got = 0;
+  ssize_t r;
+
+  while (got < len)
+  {
+    r = read( fd, buf + got, len - got );
+    if (r <= 0)
+    {
+      if (r < 0 && errno == EINTR)
+	continue;
+      if (r < 0)
+	return -1;
+      break;
+    }
+    got += r;
+  }
+
+  return got;
+}
+
+
+static int write_all( int fd, const unsigned char* buf, size_t len )
+{
+  ssize_t w;
+
+  while (len)
+  {
+    w = write( fd, buf, len );
+    if (w <= 0)
+    {
+      if (w < 0 && errno == EINTR)
+	continue;
+      if (w == 0)
+	errno = ENOSPC;
+      return 0;
+    }
+    buf += w;
+    len -= w;
+  }
+
+  return 1;
+}
+
+
+// Map the file, if it's not already.  Two threads may both map it; only
+// one mapping is kept.
+static unsigned char* map( struct dvd_part* p )
+{
+  unsigned char* m, *none = NULL;
+
+  m = __atomic_load_n( &p->map, __ATOMIC_ACQUIRE );
+  if (m != NULL)
+    return m;
+  m = mmap( NULL, (size_t)p->size << 11, PROT_READ, MAP_SHARED, p->fd, 0 );
+  if (m == MAP_FAILED)
+    return NULL;
+  if (!__atomic_compare_exchange_n( &p->map, &none, m, 0,
+				    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ))
+  {
+    munmap( m, (size_t)p->size << 11 );
+    m = none;
+  }
+
+  return m;
+}
+
+
+// Take the name of the files and the directories they take turns in
+// ("image;dir;dir").  The image's directory and name are copied, with a NUL
+// between them, followed by the other directories (the semicolons becoming
+// NULs); the name of a file is made from them by DvdName.  Returns 0 (with
+// errno) if there's no name or too many directories.
+static int set_name( struct dvd_img* d, const char* name )
+{
+  const char* base, *end = strchr( name, ';' );
+  size_t len, most;
+  char*  p;
+
+  if (end == NULL)
+    end = strchr( name, '\0' );
+  for (base = end; base > name && base[-1] != '/'; --base) ;
+  if (base == end)
+  {
+    errno = ENOENT;
+    return 0;
+  }
+  d->dir[0] = malloc( strlen( name ) + 2 );
+  if (d->dir[0] == NULL)
+    return 0;
+  memcpy( d->dir[0], name, base - name );
+  d->dir[0][base - name] = '\0';
+  d->base = d->dir[0] + (base - name) + 1;
+  strcpy( d->base, base );
+  d->dirs = 1;
+  most	  = base - name;
+  for (p = strchr( d->base, ';' ); p != NULL; p = strchr( p, ';' ))
+  {
+    *p++ = '\0';
+    if (*p == ';' || *p == '\0')
+      continue;
+    if (d->dirs == DVD_DIRS)
+    {
+      errno = E2BIG;
+      return 0;
+    }
+    d->dir[d->dirs++] = p;
+    len = strcspn( p, ";" );
+    if (len > most)
+      most = len;
+  }
+
+  d->name = malloc( most + 1 + strlen( d->base ) + 1 );
+  if (d->name == NULL)
+    return 0;
+  p = strchr( d->base, '\0' ) - 1;
+  d->first = (*p >= 'a' && *p <= 'z') ? 'a' : 'A';
+  DvdName( d, 0 );
+
+  return 1;
+}
+
+
+static void free_name( struct dvd_img* d )
+{
+  free( d->name );
+  free( d->dir[0] );
+  d->name = d->letter = d->base = d->dir[0] = NULL;
+  d->dirs = 0;
+}
+
+
+// Open the files of the image; name is that of any of them (with the
+// directories, if they're spread out).  Returns 0 (with errno) if the first
+// can't be opened, or a file other than the last is short (which would leave
+// a gap); the name is then that of the file at fault, and DvdClose frees it.
+int DvdOpen( struct dvd_img* d, const char* name )
+{
+  struct stat st;
+  int	 f, err;
+
+  memset( d, 0, sizeof(*d) );
+  for (f = 0; f < DVD_PARTS; ++f)
+    d->part[f].fd = -1;
+  if (!set_name( d, name ))
+    return 0;
+
+  for (f = 0; f < DVD_PARTS; ++f)
+  {
+    d->part[f].fd = open( DvdName( d, f ), O_RDONLY );
+    if (d->part[f].fd == -1)
+    {
+      if (f > 0 && errno == ENOENT)
+	break;
+      goto failed;
+    }
+    if (fstat( d->part[f].fd, &st ) == -1)
+      goto failed;
+    d->part[f].size = (unsigned long)(st.st_size >> 11);
+    if (f == 0)
+      d->mtime = st.st_mtim;
+  }
+  d->parts = f;
+
+  for (f = 0; f < d->parts - 1; ++f)
+  {
+    if (d->part[f].size < DVD_PART)
+    {
+      DvdName( d, f );
+      errno = EINVAL;
+      goto failed;
+    }
+  }
+  d->size = (d->parts - 1) * DVD_PART + d->part[d->parts - 1].size;
+
+  return 1;
+
+failed:
+  err = errno;
+  for (f = 0; f < DVD_PARTS; ++f)
+    if (d->part[f].fd != -1)
+      close( d->part[f].fd );
+  d->parts = 0;
+  errno = err;
+  return 0;
+}
+
+
+void DvdClose( struct dvd_img* d )
+{
+  int f;
+
+  for (f = 0; f < d->parts; ++f)
+  {
+    if (d->part[f].map != NULL)
+      munmap( d->part[f].map, (size_t)d->part[f].size << 11 );
+    close( d->part[f].fd );
+  }
+  free_name( d );
+  d->parts = 0;
+}
+
+
+// Set the name to that of a file, in its turn of the directories (not safe
+// to use whilst reading).
+const char* DvdName( struct dvd_img* d, int part )
+{
+  const char* dir = d->dir[part % d->dirs];
+  size_t len = strlen( dir );
+
+  memcpy( d->name, dir, len );
+  if (len != 0 && dir[len - 1] != '/')
+    d->name[len++] = '/';
+  strcpy( d->name + len, d->base );
+  d->letter  = strchr( d->name + len, '\0' ) - 1;
+  *d->letter = (char)(d->first + part);
+  return d->name;
+}
+
+
+// Return a pointer to count consecutive sectors, valid until DvdClose.  Up
+// to DVD_SPAN is always possible, given the overlap; more may need to cross
+// into the next file, returning NULL (as does a read beyond the image).
+const unsigned char* DvdSectors( struct dvd_img* d, unsigned long sector,
+				 unsigned count )
+{
+  unsigned long pos;
+  unsigned char* m;
+  int f;
+
+  if (count == 0 || sector >= d->size || count > d->size - sector)
+    return NULL;
+  f = (int)(sector >> 18);
+  if (f >= d->parts)		// a last file beyond 512MiB
+    f = d->parts - 1;
+  pos = sector - f * DVD_PART;
+  if (pos + count > d->part[f].size)
+    return NULL;
+  m = map( &d->part[f] );
+  return (m == NULL) ? NULL : m + (pos << 11);
+}
+
+
+// Copy count sectors to buf.  Returns the number copied, which is fewer if
+// the image ends first (or a file can't be mapped).
+unsigned long DvdRead( struct dvd_img* d, void* buf, unsigned long sector,
+		       unsigned long count )
+{
+  const unsigned char* p;
+  unsigned long done, n, pos;
+  int f;
+
+  for (done = 0; done < count && sector < d->size; done += n, sector += n)
+  {
+    f	= (int)(sector >> 18);
+    pos = sector - f * DVD_PART;
+    n	= (f < d->parts - 1) ? DVD_PART - pos : d->size - sector;
+    if (n > count - done)
+      n = count - done;
+    p = DvdSectors( d, sector, (unsigned)n );
+    if (p == NULL)
+      break;
+    memcpy( (unsigned char*)buf + (done << 11), p, n << 11 );
+  }
+
+  return done;
+}
+
+
+// Compare each overlap with the start of the next file.  Returns the first
+// file whose overlap is missing or different, or -1 if they're all good.
+int DvdCheck( struct dvd_img* d )
+{
+  unsigned char* m, *next;
+  unsigned long extra;
+  int f;
+
+  for (f = 0; f < d->parts - 1; ++f)
+  {
+    extra = d->part[f + 1].size;
+    if (extra > DVD_EXTRA)
+      extra = DVD_EXTRA;
+    if (d->part[f].size < DVD_PART + extra)
+      return f;
+    m	 = map( &d->part[f] );
+    next = map( &d->part[f + 1] );
+    if (extra && (m == NULL || next == NULL
+		  || memcmp( m + (DVD_PART << 11), next, extra << 11 ) != 0))
+      return f;
+  }
+
+  return -1;
+}
+
+
+// Write the image to fd (from its current position, which may be a pipe).
+int DvdJoin( struct dvd_img* d, int fd )
+{
+  struct xfer x;
+  long long len, done;
+  unsigned char* m;
+  int f;
+
+  memset( &x, 0, sizeof(x) );
+  x.type = SRC_FILE;
+  for (f = 0; f < d->parts; ++f)
+  {
+    len  = (long long)((f < d->parts - 1) ? DVD_PART : d->part[f].size) << 11;
+    x.fd = d->part[f].fd;
+    done = XferCopy( &x, fd, 0, len );
+    if (done < len)
+    {
+      m = map( &d->part[f] );
+      if (m == NULL || !write_all( fd, m + done, len - done ))
+	return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+// Split image (a file, device or "-" for a pipe) into files named by name's
+// last character, taking turns in its directories (see DvdOpen).  Returns the
+// number of files, or 0 (with errno).
+int DvdSplit( const char* image, const char* name )
+{
+  struct xfer x;
+  struct stat st;
+  struct timespec times[2];
+  struct dvd_img d;
+  unsigned char* buf = NULL;
+  unsigned long sectors, s, pos, n;
+  long long len, got;
+  int	 fd[2] = { -1, -1 };	// the current file and the previous one
+  int	 f, parts = 0, err;
+
+  memset( &x, 0, sizeof(x) );
+  memset( &d, 0, sizeof(d) );
+  x.fd = -1;
+  if (!set_name( &d, name ))
+    goto failed;
+  if (((strcmp( image, "-" ) == 0) ? fstat( STDIN_FILENO, &st )
+				   : stat( image, &st )) == -1)
+    goto failed;
+  if (S_ISREG( st.st_mode ) || S_ISBLK( st.st_mode ))
+  {
+    if (!XferOpen( &x, image, 0 ))
+      goto failed;
+  }
+  else
+  {
+    // Read it ourselves, to find where it ends.
+    x.fd = (strcmp( image, "-" ) == 0) ? dup( STDIN_FILENO )
+				       : open( image, O_RDONLY );
+    if (x.fd == -1)
+      goto failed;
+    x.type  = SRC_PIPE;
+    x.count = XFER_MAX;
+  }
+  buf = malloc( XFER_MAX << 11 );
+  if (buf == NULL)
+    goto failed;
+
+  if (x.type == SRC_FILE)
+    sectors = (unsigned long)(st.st_size >> 11);
+  else if (x.type == SRC_PIPE)
+    sectors = DVD_PARTS * DVD_PART + 1; 	// too big, if it gets there
+  else
+  {
+    if (!XferRead( &x, buf, 1, 16 ))
+      goto failed;
+    if (memcmp( buf + 1, ISO_ID, 5 ) == 0)
+      sectors = get32( buf + 80 );
+    else if (memcmp( buf + 9, HSF_ID, 5 ) == 0)
+      sectors = get32( buf + 88 );
+    else
+      sectors = 0;
+  }
+  if (sectors == 0)
+  {
+    errno = EINVAL;
+    goto failed;
+  }
+
+  if (x.type == SRC_FILE)
+  {
+    parts = (int)((sectors + DVD_PART - 1) / DVD_PART);
+    if (parts > DVD_PARTS)
+    {
+      errno = EFBIG;
+      goto failed;
+    }
+    times[0] = times[1] = st.st_mtim;
+    for (f = 0; f < parts; ++f)
+    {
+      fd[0] = open( DvdName( &d, f ), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+      if (fd[0] == -1)
+	goto failed;
+      s   = f * DVD_PART;
+      len = (long long)((sectors - s > DVD_PART + DVD_EXTRA)
+			? DVD_PART + DVD_EXTRA : sectors - s) << 11;
+      errno = 0;
+      if (XferCopy( &x, fd[0], s, len ) != len)
+      {
+	if (errno == 0)
+	  errno = EIO;
+	goto failed;
+      }
+      futimens( fd[0], times );
+      err = close( fd[0] );
+      fd[0] = -1;
+      if (err == -1)
+	goto failed;
+    }
+  }
+  else
+  {
+    for (s = 0; s < sectors; s += n)
+    {
+      f   = (int)(s >> 18);
+      pos = s - f * DVD_PART;
+      n = x.count;
+      if (n > sectors - s)
+	n = sectors - s;
+      if (n > DVD_PART - pos)
+	n = DVD_PART - pos;
+      if (f > 0 && pos < DVD_EXTRA && n > DVD_EXTRA - pos)
+	n = DVD_EXTRA - pos;
+      got = (long long)n << 11;
+      errno = 0;
+      if (x.type == SRC_PIPE)
+      {
+	got = read_all( x.fd, buf, got );
+	if (got < 0)
+	  goto failed;
+	if (got < (long long)n << 11)	// the end (ignoring a partial sector)
+	{
+	  n = (unsigned long)(got >> 11);
+	  if (n == 0)
+	    break;
+	  got = (long long)n << 11;
+	  sectors = s + n;
+	}
+      }
+      else if (!XferRead( &x, buf, (unsigned)n, s ))
+      {
+	if (errno == 0)
+	  errno = EIO;
+	goto failed;
+      }
+      if (pos == 0)
+      {
+	if (f == DVD_PARTS)
+	{
+	  errno = EFBIG;
+	  goto failed;
+	}
+	fd[1] = fd[0];
+	fd[0] = open( DvdName( &d, f ), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+	if (fd[0] == -1)
+	  goto failed;
+	parts = f + 1;
+      }
+      if (!write_all( fd[0], buf, got ))
+	goto failed;
+      if (fd[1] != -1)
+      {
+	if (!write_all( fd[1], buf, got ))
+	  goto failed;
+	if (pos + n == DVD_EXTRA || s + n == sectors)
+	{
+	  err = close( fd[1] );
+	  fd[1] = -1;
+	  if (err == -1)
+	    goto failed;
+	}
+      }
+    }
+    if (parts == 0)
+    {
+      errno = EINVAL;
+      goto failed;
+    }
+    for (f = 0; f < 2; ++f)
+    {
+      if (fd[f] != -1)
+      {
+	err = close( fd[f] );
+	fd[f] = -1;
+	if (err == -1)
+	  goto failed;
+      }
+    }
+  }
+
+  XferClose( &x );
+  free( buf );
+  free_name( &d );
+  return parts;
+
+failed:
+  err = errno;
+  if (fd[0] != -1)
+    close( fd[0] );
+  if (fd[1] != -1)
+    close( fd[1] );
+  XferClose( &x );
+  free( buf );
+  free_name( &d );
+  errno = err;
+  return 0;
+}
+
+
+// Sector reader for the directory library (ISODIR.C): ctx is the dvd_img.
+const unsigned char* DvdReadIso( void* ctx, unsigned long sector )
+{
+  return DvdSectors( ctx, sector, 1 );
+}
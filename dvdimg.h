@@ -0,0 +1,73 @@
+/*
+ * dvdimg.h: Read and convert a split DVD image (SHSUDVHD's .I? files).
+ *
+ * A DVD image is split into files of 512MiB, each with the first 60Ki of
+ * the next file repeated at its end, named by replacing the last character
+ * of the first file's name with 'A', 'B', etc. (or 'a', 'b', if the name
+ * ends in lowercase).  The files may take turns in several directories,
+ * given as "image;dir;dir" (as SHSUDVHD and OMI take them): the first file
+ * is in the image's own directory, the second in the first dir, and so
+ * on.  Sector n is in file n >> 18, just as SHSUDVHD finds it.  This
+ * presents the files as one image: DvdSectors points into the file holding
+ * a sector and, because of the overlap, can always return up to DVD_SPAN
+ * (62Ki, the last sector of a file and the overlap after it) consecutive
+ * sectors from a single file.  DvdRead copies any number, across the files.
+ *
+ * The files are opened by DvdOpen and stay open; each is mapped (the whole
+ * file, so this is for 64-bit hosts) the first time it's read.  Mapping is
+ * the only thing that changes after opening, and that is done atomically,
+ * so any number of threads can read at once.
+ *
+ * DvdJoin and DvdSplit convert between the split image and a single image.
+ * Neither reads into a buffer if it can help it: the blocks are shared
+ * (reflink) or copied by the kernel, as XferCopy does for ISOBAR.
+ */
+
+#ifndef DVDIMG_H
+#define DVDIMG_H
+
+#include <time.h>
+
+#define DVD_PART   262144ul	// sectors in each file (512MiB)
+#define DVD_EXTRA  30		// sectors of the next file repeated (60Ki)
+#define DVD_SPAN   31		// sectors always available in one file
+#define DVD_PARTS  26		// 'A' to 'Z'
+#define DVD_DIRS   8		// directories SHSUDVHD allows
+
+struct dvd_part
+{
+  int		fd;
+  unsigned long size;		// sectors in the file (including the overlap)
+  unsigned char* map;		// the whole file, once it's been read
+};
+
+struct dvd_img
+{
+  char* 	name;		// name of the current file
+  char* 	letter; 	// its last character
+  char		first;		// 'A' or 'a'
+  char* 	base;		// the file's name without its directory
+  char* 	dir[DVD_DIRS];	// directories the files take turns in
+  int		dirs;		//  (the image's own is the first)
+  int		parts;
+  unsigned long size;		// sectors in the image
+  struct timespec mtime;	// of the first file
+  struct dvd_part part[DVD_PARTS];
+};
+
+int	DvdOpen( struct dvd_img* d, const char* name );
+void	DvdClose( struct dvd_img* d );
+const char* DvdName( struct dvd_img* d, int part );
+
+const unsigned char* DvdSectors( struct dvd_img* d, unsigned long sector,
+				 unsigned count );
+unsigned long DvdRead( struct dvd_img* d, void* buf, unsigned long sector,
+		       unsigned long count );
+int	DvdCheck( struct dvd_img* d );
+
+int	DvdJoin( struct dvd_img* d, int fd );
+int	DvdSplit( const char* image, const char* name );
+
+const unsigned char* DvdReadIso( void* ctx, unsigned long sector );
+
+#endif
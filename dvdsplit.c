@@ -0,0 +1,175 @@
+/*
+ * dvdsplit.c: Join a split DVD image (SHSUDVHD's .I? files) into a single
+ *	       image, or split an image for SHSUDVHD.
+ *
+ * Uses the split image library (DVDIMG.C), so the files are shared with the
+ * result where the file system allows it (reflink), otherwise copied by the
+ * kernel; they don't pass through here.  The overlap at the end of each file
+ * is left out when joining and made again when splitting, so joining what
+ * was split (or splitting what was joined) gives the same files.  Joining
+ * (or listing) checks each overlap against the start of the next file;
+ * a difference is reported, but doesn't stop the join (it's not used).
+ *
+ * Build with MAKEFILE.LNX.
+ */
+
+#define PVERS "1.00"
+#define PDATE "17 October, 2026"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "dvdimg.h"
+#include "isodir.h"
+
+
+void fail( const char* msg, const char* name )
+{
+  fprintf( stderr, "ERROR: %s", msg );
+  if (name)
+    fprintf( stderr, " \"%s\"", name );
+  if (errno)
+    fprintf( stderr, ": %s", strerror( errno ) );
+  fputs( ".\n", stderr );
+  exit( 1 );
+}
+
+
+void check( struct dvd_img* d )
+{
+  int f = DvdCheck( d );
+
+  if (f >= 0)
+  {
+    fprintf( stderr, "WARNING: the end of \"%s\"", DvdName( d, f ) );
+    fprintf( stderr, " does not match the start of \"%s\".\n",
+	     DvdName( d, f + 1 ) );
+  }
+}
+
+
+void list( struct dvd_img* d )
+{
+  struct iso_vol v;
+  int f;
+
+  for (f = 0; f < d->parts; ++f)
+    printf( "%s\t%lu\n", DvdName( d, f ), d->part[f].size );
+  if (IsoOpen( &v, DvdReadIso, d, 0 ))
+    printf( "Label: %s\n", v.label );
+  printf( "Sectors: %lu\n", d->size );
+  check( d );
+}
+
+
+void usage( void )
+{
+  puts(
+"DVDSPLIT - join or split a SHSUDVHD image.\n"
+"Version " PVERS " (" PDATE "). Freeware.\n"
+"http://shsucdx.adoxa.vze.com/\n"
+"\n"
+"Join the files of a split image (as used by SHSUDVHD), or split an image.\n"
+"\n"
+"dvdsplit image.iA [image]\n"
+"dvdsplit -s image image.iA\n"
+"\n"
+"  image.iA\tthe first file (its last character counts the files); add\n"
+"\t\t\";dir;dir\" if the files take turns in other directories\n"
+"  image\t\tsingle image (\"-\" for standard output or input);\n"
+"\t\twithout it, list the files\n"
+"  -s\t\tsplit the image"
+  );
+}
+
+
+int main( int argc, char* argv[] )
+{
+  struct dvd_img d;
+  struct timespec times[2];
+  const char* name[2] = { NULL, NULL };
+  int	split = 0;
+  int	fd, i, n = 0;
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (*argv[i] == '-' && argv[i][1] != '\0')
+    {
+      switch (argv[i][1])
+      {
+	case 's':
+	  split = 1;
+	  break;
+	case '?':
+	case '-':
+	  usage();
+	  return 0;
+	default:
+	  fprintf( stderr, "ERROR: unknown option: %s.\n", argv[i] );
+	  return 1;
+      }
+    }
+    else if (n < 2)
+      name[n++] = argv[i];
+    else
+    {
+      fprintf( stderr, "ERROR: too many names: %s.\n", argv[i] );
+      return 1;
+    }
+  }
+  if (n == 0 || (split && n != 2))
+  {
+    usage();
+    return 1;
+  }
+
+  if (split)
+  {
+    errno = 0;
+    n = DvdSplit( name[0], name[1] );
+    if (n == 0)
+      fail( "unable to split", name[0] );
+    return 0;
+  }
+
+  if (!DvdOpen( &d, name[0] ))
+  {
+    if (errno == EINVAL)
+    {
+      errno = 0;
+      fail( "file is too short", d.name );
+    }
+    fail( "unable to open", (d.name != NULL) ? d.name : name[0] );
+  }
+  if (name[1] == NULL)
+    list( &d );
+  else
+  {
+    check( &d );
+    if (strcmp( name[1], "-" ) == 0)
+      fd = STDOUT_FILENO;
+    else
+    {
+      fd = open( name[1], O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+      if (fd == -1)
+	fail( "unable to create", name[1] );
+    }
+    errno = 0;
+    if (!DvdJoin( &d, fd ))
+      fail( "unable to write", name[1] );
+    if (fd != STDOUT_FILENO)
+    {
+      times[0] = times[1] = d.mtime;
+      futimens( fd, times );
+      if (close( fd ) == -1)
+	fail( "unable to write", name[1] );
+    }
+  }
+  DvdClose( &d );
+
+  return 0;
+}
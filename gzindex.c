@@ -0,0 +1,322 @@
+/*
+ * gzindex.c: Index a gzipped image, so SHSUCDHD and SHSUCDRD can read it
+ *	      without inflating it first.
+ *
+ * A deflate stream can only be inflated from its start, so SHSUCDRD has to
+ * inflate the whole of a gzipped image into XMS before it can be used.  This
+ * inflates it once (as zlib's zran.c example does) and records, for each
+ * slot of the image (1MiB by default), the last block of the stream to start
+ * at or before the slot, together with the 32Ki of the image before it (the
+ * window, which the block may refer back to).  A driver then only needs to
+ * restore the window and inflate from the block before the read.  Windows
+ * are themselves deflated, to keep the index small; a window that serves
+ * several slots (a block spanning them) is only stored once.
+ *
+ * The index has the name of the image, with an extension of ".gzi"; see
+ * IMAGE.TXT for its format.
+ *
+ * Build with MAKEFILE.LNX (needs zlib).
+ */
+
+#define PVERS "1.00"
+#define PDATE "17 October, 2026"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define GZI_WINDOW 32768	// also the chunk a driver inflates
+#define GZI_HEADER 24
+#define GZI_SLOT   16
+#define GZI_VERSION 1
+
+#define INBUF 16384
+
+
+// Where a block starts, and the window before it.
+struct point
+{
+  unsigned long out, in;	// position in the image and the gzip file
+  int		bits, prime;	// bits of the previous byte still unused
+  unsigned	winlen; 	// the window, once written
+  unsigned long winpos;
+  unsigned char window[GZI_WINDOW];
+};
+
+struct point   cand;		// last block start at or before next_slot
+unsigned char* table;		// the slots, as written
+unsigned long  slots, next_slot;
+int	       shift = 20;	// 1MiB
+
+FILE*	       idx;
+unsigned long  idx_pos; 	// where the next window is written
+unsigned char  packed[GZI_WINDOW + 1024];
+
+
+void put16( unsigned char* p, unsigned n )
+{
+  p[0] = n;
+  p[1] = n >> 8;
+}
+
+void put32( unsigned char* p, unsigned long n )
+{
+  put16( p, n & 0xffff );
+  put16( p + 2, n >> 16 );
+}
+
+unsigned long get32( const unsigned char* p )
+{
+  return p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16)
+	 | ((unsigned long)p[3] << 24);
+}
+
+
+void fail( const char* msg, const char* name )
+{
+  fprintf( stderr, "ERROR: %s", msg );
+  if (name)
+    fprintf( stderr, " \"%s\"", name );
+  fputs( ".\n", stderr );
+  exit( 1 );
+}
+
+
+// Deflate the candidate's window into the index (if it's not already there).
+void write_window( void )
+{
+  z_stream z;
+
+  if (cand.winlen != 0)
+    return;
+
+  memset( &z, 0, sizeof(z) );
+  if (deflateInit2( &z, 9, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY ) != Z_OK)
+    fail( "not enough memory", NULL );
+  z.next_in   = cand.window;
+  z.avail_in  = GZI_WINDOW;
+  z.next_out  = packed;
+  z.avail_out = sizeof(packed);
+  if (deflate( &z, Z_FINISH ) != Z_STREAM_END)
+    fail( "unable to deflate a window", NULL );
+  cand.winlen = sizeof(packed) - z.avail_out;
+  cand.winpos = idx_pos;
+  deflateEnd( &z );
+
+  if (fwrite( packed, cand.winlen, 1, idx ) != 1)
+    fail( "unable to write the index", NULL );
+  idx_pos += cand.winlen;
+}
+
+
+// Give every slot before out the current candidate.
+void fill_slots( unsigned long long out )
+{
+  unsigned char* s;
+
+  while (next_slot < slots && out > (unsigned long long)next_slot << shift)
+  {
+    write_window();
+    s = table + next_slot * GZI_SLOT;
+    put32( s,	   cand.out );
+    put32( s + 4,  cand.in );
+    s[8] = cand.bits;
+    s[9] = cand.prime;
+    put16( s + 10, cand.winlen );
+    put32( s + 12, cand.winpos );
+    ++next_slot;
+  }
+}
+
+
+void usage( void )
+{
+  puts(
+"GZINDEX - index a gzipped image for SHSUCDHD and SHSUCDRD.\n"
+"Version " PVERS " (" PDATE "). Freeware.\n"
+"http://shsucdx.adoxa.vze.com/\n"
+"\n"
+"Index a gzipped image, so SHSUCDHD and SHSUCDRD can read it directly.\n"
+"\n"
+"gzindex [-m MiB] image [index]\n"
+"\n"
+"  -m\tsize of each slot (a power of two, default is 1);\n"
+"\tsmaller is quicker to read, but a bigger index\n"
+"  index\tdefault is the image with an extension of \".gzi\""
+  );
+}
+
+
+int main( int argc, char* argv[] )
+{
+  const char*	image = NULL;
+  char* 	name = NULL;
+  char* 	dot;
+  FILE* 	gz;
+  z_stream	z;
+  unsigned char in[INBUF], header[GZI_HEADER];
+  unsigned char window[GZI_WINDOW];
+  unsigned char last = 0;	// byte before the input buffer
+  unsigned long long out = 0, pos = 0;
+  unsigned long gz_size, crc, isize, sectors = 0;
+  unsigned long mib;
+  int		i, rc, got = 0;
+
+  for (i = 1; i < argc; ++i)
+  {
+    if (*argv[i] == '-' && argv[i][1] != '\0')
+    {
+      switch (argv[i][1])
+      {
+	case 'm':
+	  mib = strtoul( (argv[i][2] == '\0' && argv[i+1] != NULL)
+			 ? argv[++i] : argv[i] + 2, NULL, 0 );
+	  if (mib == 0 || mib > 1024 || (mib & (mib - 1)))
+	  {
+	    fputs( "ERROR: slot size must be a power of two, up to 1024.\n",
+		   stderr );
+	    return 1;
+	  }
+	  for (shift = 20; (1ul << (shift - 20)) != mib; ++shift) ;
+	  break;
+	case '?':
+	case '-':
+	  usage();
+	  return 0;
+	default:
+	  fprintf( stderr, "ERROR: unknown option: %s.\n", argv[i] );
+	  return 1;
+      }
+    }
+    else if (image == NULL)
+      image = argv[i];
+    else
+      name = argv[i];
+  }
+  if (image == NULL)
+  {
+    usage();
+    return 1;
+  }
+  if (name == NULL)
+  {
+    name = malloc( strlen( image ) + 5 );
+    strcpy( name, image );
+    dot = strrchr( name, '.' );
+    if (dot == NULL || strchr( dot, '/' ) != NULL)
+      dot = name + strlen( name );
+    strcpy( dot, ".gzi" );
+  }
+
+  gz = fopen( image, "rb" );
+  if (gz == NULL)
+    fail( "unable to open", image );
+  // The trailer has the CRC (to recognise the image) and the size.
+  if (fseek( gz, -8, SEEK_END ) != 0 || fread( in, 8, 1, gz ) != 1)
+    fail( "not a gzipped image:", image );
+  gz_size = ftell( gz );
+  crc	  = get32( in );
+  isize   = get32( in + 4 );
+  rewind( gz );
+
+  slots = (isize == 0) ? 0 : ((isize - 1) >> shift) + 1;
+  table = calloc( slots ? slots : 1, GZI_SLOT );
+  if (table == NULL)
+    fail( "not enough memory", NULL );
+
+  idx = fopen( name, "wb" );
+  if (idx == NULL)
+    fail( "unable to create", name );
+  idx_pos = GZI_HEADER + slots * GZI_SLOT;
+  if (fseek( idx, idx_pos, SEEK_SET ) != 0)
+    fail( "unable to write", name );
+
+  memset( &z, 0, sizeof(z) );
+  if (inflateInit2( &z, 16 + 15 ) != Z_OK)
+    fail( "not enough memory", NULL );
+  memset( window, 0, sizeof(window) );
+  z.avail_out = 0;
+  do
+  {
+    if (z.avail_in == 0)
+    {
+      if (got)
+	last = in[got - 1];
+      got = fread( in, 1, INBUF, gz );
+      if (got == 0)
+	fail( "unexpected end of", image );
+      z.next_in  = in;
+      z.avail_in = got;
+    }
+    do
+    {
+      if (z.avail_out == 0)
+      {
+	z.next_out  = window;
+	z.avail_out = GZI_WINDOW;
+      }
+      pos += z.avail_in;
+      out += z.avail_out;
+      rc = inflate( &z, Z_BLOCK );
+      pos -= z.avail_in;
+      out -= z.avail_out;
+      if (rc == Z_NEED_DICT || rc == Z_DATA_ERROR || rc == Z_MEM_ERROR)
+	fail( "not a gzipped image (or it's corrupt):", image );
+
+      // The primary volume descriptor (sector 16) has the volume size.
+      if (sectors == 0 && out >= 16 * 2048 + 92)
+      {
+	if (memcmp( window + 1, "CD001", 5 ) == 0)
+	  sectors = get32( window + 80 );
+	else if (memcmp( window + 9, "CDROM", 5 ) == 0)
+	  sectors = get32( window + 88 );
+	else
+	  fail( "not a CD image:", image );
+      }
+      if (rc == Z_STREAM_END)
+	break;
+
+      // The start of a block (other than the end of the last).
+      if ((z.data_type & 128) && !(z.data_type & 64))
+      {
+	fill_slots( out );
+	cand.out    = out;
+	cand.in     = pos;
+	cand.bits   = z.data_type & 7;
+	cand.prime  = 0;
+	if (cand.bits)
+	  cand.prime = ((z.next_in == in) ? last : z.next_in[-1])
+		       >> (8 - cand.bits);
+	cand.winlen = 0;
+	memcpy( cand.window, window, GZI_WINDOW );
+      }
+    } while (z.avail_in != 0);
+  } while (rc != Z_STREAM_END);
+  inflateEnd( &z );
+
+  if (out != isize || pos != gz_size)
+    fail( "only single-member images (less than 4GiB) can be indexed:",
+	  image );
+  if (sectors == 0)
+    fail( "not a CD image:", image );
+  fill_slots( out );
+  fclose( gz );
+
+  memcpy( header, "GZI\x1a", 4 );
+  put16( header + 4,  GZI_VERSION );
+  put16( header + 6,  shift );
+  put32( header + 8,  slots );
+  put32( header + 12, sectors );
+  put32( header + 16, gz_size );
+  put32( header + 20, crc );
+  if (fseek( idx, 0, SEEK_SET ) != 0
+      || fwrite( header, GZI_HEADER, 1, idx ) != 1
+      || fwrite( table, GZI_SLOT, slots, idx ) != slots
+      || fclose( idx ) != 0)
+    fail( "unable to write", name );
+
+  printf( "%s: %lu slots of %luMiB, %lu bytes.\n",
+	  name, slots, 1ul << (shift - 20), idx_pos );
+  return 0;
+}
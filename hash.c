@@ -0,0 +1,286 @@
+/*
+ * hash.c: CRC-32, MD5 and SHA-256 for the POSIX version of OMI.
+ *
+ * These are the straightforward versions (RFC 1321 and FIPS 180-4), with the
+ * CRC done eight bytes at a time ("slicing-by-8").  OMI runs each in its own
+ * thread, so the three together keep up with anything but the fastest disk;
+ * a sector at a time is already a whole number of blocks, so the copying to
+ * the block buffer is only done at the end.
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include "hash.h"
+
+
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init( void )
+{
+  uint32_t c;
+  int	   n, k;
+
+  for (n = 0; n < 256; ++n)
+  {
+    c = n;
+    for (k = 0; k < 8; ++k)
+      c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    crc_table[0][n] = c;
+  }
+  for (n = 0; n < 256; ++n)
+  {
+    c = crc_table[0][n];
+    for (k = 1; k < 8; ++k)
+    {
+      c = crc_table[0][c & 0xFF] ^ (c >> 8);
+      crc_table[k][n] = c;
+    }
+  }
+}
+
+
+uint32_t Crc32( uint32_t crc, const void* buf, size_t len )
+{
+  const unsigned char* p = buf;
+  uint32_t lo, hi;
+
+  pthread_once( &crc_once, crc_init );
+  crc = ~crc;
+  for (; len >= 8; len -= 8, p += 8)
+  {
+    lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+    hi = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+    crc = crc_table[7][lo & 0xFF]	  ^ crc_table[6][(lo >> 8) & 0xFF]
+	^ crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24]
+	^ crc_table[3][hi & 0xFF]	  ^ crc_table[2][(hi >> 8) & 0xFF]
+	^ crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+  }
+  while (len--)
+    crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+
+#define ROL( x, n ) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR( x, n ) (((x) >> (n)) | ((x) << (32 - (n))))
+
+
+static const uint32_t md5_k[64] =
+{
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+  0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+  0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+  0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+  0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+  0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+  0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+  0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+  0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const unsigned char md5_r[16] =
+{
+  7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21
+};
+
+
+static void md5_block( uint32_t* s, const unsigned char* p )
+{
+  uint32_t w[16], a, b, c, d, f, t;
+  int	   i, g;
+
+  for (i = 0; i < 16; ++i, p += 4)
+    w[i] = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+
+  a = s[0]; b = s[1]; c = s[2]; d = s[3];
+  for (i = 0; i < 64; ++i)
+  {
+    switch (i >> 4)
+    {
+      case 0:  f = (b & c) | (~b & d); g = i;		 break;
+      case 1:  f = (d & b) | (~d & c); g = (5*i + 1) & 15; break;
+      case 2:  f = b ^ c ^ d;	       g = (3*i + 5) & 15; break;
+      default: f = c ^ (b | ~d);       g = (7*i) & 15;	 break;
+    }
+    t = d;
+    d = c;
+    c = b;
+    f += a + md5_k[i] + w[g];
+    b += ROL( f, md5_r[(i >> 4) * 4 + (i & 3)] );
+    a = t;
+  }
+  s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+}
+
+
+void Md5Init( struct md5* h )
+{
+  h->state[0] = 0x67452301;
+  h->state[1] = 0xefcdab89;
+  h->state[2] = 0x98badcfe;
+  h->state[3] = 0x10325476;
+  h->len = 0;
+}
+
+
+void Md5Update( struct md5* h, const void* buf, size_t len )
+{
+  const unsigned char* p = buf;
+  unsigned fill = h->len & 63;
+
+  h->len += len;
+  if (fill)
+  {
+    if (len < 64 - fill)
+    {
+      memcpy( h->buf + fill, p, len );
+      return;
+    }
+    memcpy( h->buf + fill, p, 64 - fill );
+    md5_block( h->state, h->buf );
+    p	+= 64 - fill;
+    len -= 64 - fill;
+  }
+  for (; len >= 64; len -= 64, p += 64)
+    md5_block( h->state, p );
+  memcpy( h->buf, p, len );
+}
+
+
+void Md5Final( struct md5* h, unsigned char* digest )
+{
+  unsigned long long bits = h->len << 3;
+  unsigned char pad[72];
+  unsigned fill = h->len & 63;
+  int	   i, n;
+
+  n = (fill < 56) ? 56 - fill : 120 - fill;
+  memset( pad, 0, n );
+  pad[0] = 0x80;
+  for (i = 0; i < 8; ++i)
+    pad[n + i] = (unsigned char)(bits >> (i * 8));
+  Md5Update( h, pad, n + 8 );
+
+  for (i = 0; i < 16; ++i)
+    digest[i] = (unsigned char)(h->state[i >> 2] >> ((i & 3) * 8));
+}
+
+
+static const uint32_t sha_k[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+static void sha_block( uint32_t* s, const unsigned char* p )
+{
+  uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+  int	   i;
+
+  for (i = 0; i < 16; ++i, p += 4)
+    w[i] = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+  for (; i < 64; ++i)
+    w[i] = w[i-16] + w[i-7]
+	 + (ROR( w[i-15], 7 ) ^ ROR( w[i-15], 18 ) ^ (w[i-15] >> 3))
+	 + (ROR( w[i-2], 17 ) ^ ROR( w[i-2], 19 ) ^ (w[i-2] >> 10));
+
+  a = s[0]; b = s[1]; c = s[2]; d = s[3];
+  e = s[4]; f = s[5]; g = s[6]; h = s[7];
+  for (i = 0; i < 64; ++i)
+  {
+    t1 = h + (ROR( e, 6 ) ^ ROR( e, 11 ) ^ ROR( e, 25 ))
+	   + ((e & f) ^ (~e & g)) + sha_k[i] + w[i];
+    t2 = (ROR( a, 2 ) ^ ROR( a, 13 ) ^ ROR( a, 22 ))
+	 + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+  s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+}
+
+
+void Sha256Init( struct sha256* h )
+{
+  static const uint32_t iv[8] =
+  {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+
+  memcpy( h->state, iv, sizeof(iv) );
+  h->len = 0;
+}
+
+
+void Sha256Update( struct sha256* h, const void* buf, size_t len )
+{
+  const unsigned char* p = buf;
+  unsigned fill = h->len & 63;
+
+  h->len += len;
+  if (fill)
+  {
+    if (len < 64 - fill)
+    {
+      memcpy( h->buf + fill, p, len );
+      return;
+    }
+    memcpy( h->buf + fill, p, 64 - fill );
+    sha_block( h->state, h->buf );
+    p	+= 64 - fill;
+    len -= 64 - fill;
+  }
+  for (; len >= 64; len -= 64, p += 64)
+    sha_block( h->state, p );
+  memcpy( h->buf, p, len );
+}
+
+
+void Sha256Final( struct sha256* h, unsigned char* digest )
+{
+  unsigned long long bits = h->len << 3;
+  unsigned char pad[72];
+  unsigned fill = h->len & 63;
+  int	   i, n;
+
+  n = (fill < 56) ? 56 - fill : 120 - fill;
+  memset( pad, 0, n );
+  pad[0] = 0x80;
+  for (i = 0; i < 8; ++i)
+    pad[n + i] = (unsigned char)(bits >> ((7 - i) * 8));
+  Sha256Update( h, pad, n + 8 );
+
+  for (i = 0; i < 32; ++i)
+    digest[i] = (unsigned char)(h->state[i >> 2] >> ((3 - (i & 3)) * 8));
+}
+
+
+char* HashHex( char* hex, const unsigned char* digest, int len )
+{
+  static const char digits[] = "0123456789abcdef";
+  char* p = hex;
+
+  while (len--)
+  {
+    *p++ = digits[*digest >> 4];
+    *p++ = digits[*digest++ & 15];
+  }
+  *p = '\0';
+
+  return hex;
+}
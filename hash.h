@@ -0,0 +1,44 @@
+/*
+ * hash.h: CRC-32, MD5 and SHA-256 for the POSIX version of OMI.
+ *
+ * Each is updated with any number of bytes at a time.  The CRC is the one
+ * used by zip, gzip and cksum -a crc32b (starting from 0); the digests are
+ * those of md5sum and sha256sum.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MD5_SIZE    16
+#define SHA256_SIZE 32
+
+struct md5
+{
+  uint32_t	     state[4];
+  unsigned long long len;	// bytes so far
+  unsigned char      buf[64];
+};
+
+struct sha256
+{
+  uint32_t	     state[8];
+  unsigned long long len;
+  unsigned char      buf[64];
+};
+
+uint32_t Crc32( uint32_t crc, const void* buf, size_t len );
+
+void	 Md5Init( struct md5* h );
+void	 Md5Update( struct md5* h, const void* buf, size_t len );
+void	 Md5Final( struct md5* h, unsigned char* digest );
+
+void	 Sha256Init( struct sha256* h );
+void	 Sha256Update( struct sha256* h, const void* buf, size_t len );
+void	 Sha256Final( struct sha256* h, unsigned char* digest );
+
+char*	 HashHex( char* hex, const unsigned char* digest, int len );
+
+#endif
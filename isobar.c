@@ -14,27 +14,56 @@
  * v1.02, 5 & 6 June, 2005:
  *   Win32 port.
  *
+ * v1.03, 17 October, 2026:
+ *   POSIX port (source can be a device, image file or pipe, with the number
+ *    of sectors read at a time tuned to suit, or given with -t);
+ *   extract from an image file with reflink, copy_file_range or mmap, so the
+ *    boot image doesn't pass through buf (POSIX);
+ *   batch mode: inspect many images in parallel, listing them as CSV or
+ *    JSON (POSIX);
+ *   recognise boot sections (display all entries, -a to extract them all,
+ *    reading the disc once, in order).
+ *
  * Todo: possibly replace the boot image in a CD image;
- *	 recognise boot sections;
  *	 ignore non-bootable CDs (are there any?).
  */
 
-#define PVERS "1.02"
-#define PDATE "6 June, 2005"
+#define PVERS "1.03"
+#define PDATE "17 October, 2026"
 
+#ifdef __unix__
+#define _GNU_SOURCE		// nftw
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
-#include <io.h>
 
 #ifdef _WIN32
+#include <io.h>
 #include <windows.h>
 #define far
 #define farmalloc malloc
 #define _fstrcmp strcmp
-#define SFMT "s"
 #define MAX 32
+#define TLS
+#elif defined( __unix__ )
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <pthread.h>
+#include "xfer.h"
+#define far
+#define farmalloc malloc
+#define _fstrcmp strcmp
+typedef unsigned char  BYTE;
+typedef unsigned short WORD;
+typedef unsigned int   DWORD;	// the catalog needs it to be 32 bits
+typedef unsigned int   UINT;
+#define MAX (src.count)
+#define TLS __thread		// each batch thread has its own source
 #else
+#include <io.h>
 #include <dos.h>
 #include <alloc.h>
 #include <string.h>
@@ -42,18 +71,57 @@ typedef unsigned char BYTE;
 typedef unsigned int  WORD;
 typedef unsigned long DWORD;
 typedef unsigned int  UINT;
-#define SFMT "Fs"
 #define MAX 30u
+#define TLS
 #endif
 
+#define MAX_ENTRY  32	// boot entries remembered
+#define MAX_CATSEC 8	// sectors of the catalog searched for sections
+
+struct entry
+{
+  int	section;	// 0 for the default entry
+  BYTE	platform;
+  char	id[29];		// section ID string
+  BYTE	indicator;	// 0x88 if bootable
+  BYTE	media;		// boot type (low nibble)
+  WORD	segment;
+  BYTE	system;
+  WORD	count;		// sectors loaded by the BIOS
+  DWORD sector;		// image sector
+  long	offset; 	// first sector to extract
+  long	size;		// bytes to extract
+  long	done;		// bytes extracted
+  int	fd;		// file being extracted to
+};
+
+struct boot
+{
+  DWORD catalog;	// sector of the boot catalog
+  BYTE	platform;
+  char	id[25];
+  int	entries;
+  struct entry entry[MAX_ENTRY];
+};
+
+int  Inspect( struct boot* b, int drive );
+void ShowBoot( const struct boot* b );
+int  Extract( struct entry** e, int cnt );
+void SortEntries( const struct boot* b, struct entry** e );
+const char* PlatformName( BYTE id );
 int  CDReadLong( UINT SectorCount, DWORD StartSector );
 
-char far* buf;
+TLS char far* buf;
 int  CD = -1;
-long offset = 0, imgsize, blksize;
 #ifdef _WIN32
 HANDLE fdin;
 #define OFLAG _O_BINARY | _O_CREAT | _O_WRONLY | _O_TRUNC
+#elif defined( __unix__ )
+TLS struct xfer src;
+UINT xfer_count;	// sectors per read given by the user (0 to tune)
+int  Batch( char** paths, int cnt, const char* list, int json, int threads,
+	    int drive );
+#define OFLAG O_CREAT | O_WRONLY | O_TRUNC
 #else
 int  fdin = 0;
 extern int _fmode;
@@ -63,6 +131,7 @@ extern int _fmode;
 const char* platform[] = { "80x86",
 			   "Power PC",
 			   "Mac" };
+#define PLATFORM_EFI 0xEF
 
 const char* boot_type[] = { "no emulation",
 			    "1.2 meg floppy",
@@ -70,6 +139,14 @@ const char* boot_type[] = { "no emulation",
 			    "2.88 meg floppy",
 			    "hard disk" };
 
+// Problems found by Inspect.
+enum { BAD_NONE, BAD_READ, BAD_TORITO, BAD_CATALOG, BAD_OPEN };
+const char* bad_msg[] = { "",
+			  "read error",
+			  "is not EL TORITO",
+			  "has an invalid boot catalog",
+			  "cannot be opened" };
+
 enum
 {
   E_OK, 		// No problems
@@ -92,14 +169,31 @@ void usage( void )
 "\n"
 "Extract the boot image (or code) from a bootable CD-ROM or .ISO image.\n"
 "\n"
-"isobar [-o file [-d]] [iso-file|CD-ROM-drive]\n"
+"isobar [-o file [-a] [-d]] [iso-file|CD-ROM-drive]\n"
 "\n"
 "-o file       Write the boot image (or code) to the specified filename\n"
 "                (without this boot information is displayed).\n"
+"-a            Write every boot image, to file plus the entry number and\n"
+"                \".img\" (or \".bin\" for code).\n"
 "-d            For a hard disk image just write the drive (strip MBR).\n"
+#ifdef __unix__
+"-t count      Number of sectors to read at a time (default is tuned).\n"
+"iso-file      An image of a bootable CD-ROM (\"-\" is standard input).\n"
+"CD-ROM-drive  The device of a CD-ROM containing a bootable disc\n"
+"                (default is /dev/cdrom).\n"
+"\n"
+"isobar -c|-j [-d] [-p threads] [-l list] [iso-file|directory]...\n"
+"\n"
+"-c            List the boot information of many images as CSV\n"
+"-j              or JSON, reading them in parallel.\n"
+"-p threads    Number of images to read at once (default is processors).\n"
+"-l list       Also read the names of images from list (\"-\" is stdin).\n"
+"directory     Search for \".iso\" files (and its subdirectories).\n"
+#else
 "iso-file      An image of a bootable CD-ROM.\n"
 "CD-ROM-drive  The drive letter of a CD-ROM containing a bootable disc\n"
 "                (default is first CD).\n"
+#endif
 "\n"
 "ISOBAR was derived from the program by David Brinkman."
 
@@ -112,15 +206,22 @@ void usage( void )
 int main( int argc, char* argv[] )
 {
   int	i;
-  int	fdout = 0;
   char *outfile = NULL, *isofile = NULL, cdbuf[8];
-  DWORD bootfound;
-  int	drive = 0;
-  int	type;
-  DWORD n;
-  UINT	len, w;
+  static struct boot boot;
+  struct entry* out[MAX_ENTRY];
+  char	name[260];
+  int	drive = 0, all = 0;
+  int	outs;
+#ifdef _WIN32
+  UINT	len;
+#endif
+#ifdef __unix__
+  char** paths = malloc( argc * sizeof(char*) );
+  char*  list = NULL;
+  int	 cnt = 0, batch = 0, threads = 0;
+#endif
 
-#ifndef _WIN32
+#if !defined( _WIN32 ) && !defined( __unix__ )
   union REGS regs;
 
   _fmode = O_BINARY;
@@ -133,7 +234,11 @@ int main( int argc, char* argv[] )
 
     for (i = 1; i < argc; ++i)
     {
+#ifdef __unix__
+      if (*argv[i] == '-' && argv[i][1] != '\0')	// '/' starts a path
+#else
       if (*argv[i] == '-' || *argv[i] == '/')
+#endif
       {
 	switch (argv[i][1] | 0x20)
 	{
@@ -150,6 +255,32 @@ int main( int argc, char* argv[] )
 	    drive = 1;
 	  break;
 
+	  case 'a':
+	    all = 1;
+	  break;
+
+#ifdef __unix__
+	  case 't':
+	    xfer_count = strtoul( (argv[i][2] == '\0' && argv[i+1] != NULL)
+				  ? argv[++i] : argv[i] + 2, NULL, 0 );
+	  break;
+
+	  case 'c':
+	  case 'j':
+	    batch = argv[i][1] | 0x20;
+	  break;
+
+	  case 'p':
+	    threads = strtoul( (argv[i][2] == '\0' && argv[i+1] != NULL)
+			       ? argv[++i] : argv[i] + 2, NULL, 0 );
+	  break;
+
+	  case 'l':
+	    list = (argv[i][2] == '\0' && argv[i+1] != NULL) ? argv[++i]
+							      : argv[i] + 2;
+	  break;
+#endif
+
 	  default:
 	    fprintf( stderr, "ERROR: unknown option: %s.\n", argv[i] );
 	    return E_OPT;
@@ -158,10 +289,18 @@ int main( int argc, char* argv[] )
       else
       {
 	isofile = argv[i];
+#ifdef __unix__
+	paths[cnt++] = argv[i];
+#endif
       }
     }
   }
 
+#ifdef __unix__
+  if (batch)
+    return Batch( paths, cnt, list, (batch == 'j'), threads, drive );
+#endif
+
 #ifdef _WIN32
   if (!isofile)
   {
@@ -209,6 +348,16 @@ int main( int argc, char* argv[] )
   if (CD != -1)
     isofile = cdbuf + 4;
 
+#elif defined( __unix__ )
+  (void)cdbuf;
+  if (!isofile)
+    isofile = "/dev/cdrom";
+  if (!XferOpen( &src, isofile, xfer_count ))
+  {
+    fprintf( stderr, "ERROR: Cannot open %s.\n", isofile );
+    return E_NOCD;
+  }
+
 #else
   if (!isofile)
   {
@@ -255,133 +404,359 @@ int main( int argc, char* argv[] )
   }
 #endif
 
+#ifdef __unix__
+  buf = farmalloc( XFER_MAX << 11 ); // the count may be tuned up to this
+#else
   buf = farmalloc( MAX << 11 ); // transfer up to MAX blocks at a time
+#endif
   if (buf == NULL)
   {
     fputs( "ERROR: Not enough memory.\n", stderr );
     return E_MEM;
   }
 
-  if (!CDReadLong( 1, 0x11 ))
+  i = Inspect( &boot, drive );
+  if (i == BAD_READ)
   {
     fputs( "Read error!\n", stderr );
     return E_ABORTED;
   }
-
-  if (_fstrcmp( buf+1, "CD001\01EL TORITO SPECIFICATION" ))
+  if (i != BAD_NONE)
   {
-    fprintf( stderr, "ERROR: %s is not EL TORITO.\n", isofile );
+    fprintf( stderr, "ERROR: %s %s.\n", isofile, bad_msg[i] );
     return E_NOCD;
   }
-  bootfound = *(DWORD far*)(buf+0x47);
-  printf( "Catalog Sector:\t%lx\n", bootfound );
+  ShowBoot( &boot );
 
-  if (!CDReadLong( 1, bootfound ))
+  if (outfile)
   {
-    fputs( "Read error!\n", stderr );
-    return E_ABORTED;
+    if (all)
+      SortEntries( &boot, out );
+    else
+      out[0] = &boot.entry[0];
+    for (outs = 0; outs < ((all) ? boot.entries : 1); ++outs)
+    {
+      if (all)
+	sprintf( name, "%s%d.%s", outfile, (int)(out[outs] - boot.entry),
+		 (out[outs]->media & 15) ? "img" : "bin" );
+      else
+	strcpy( name, outfile );
+      out[outs]->fd = open( name, OFLAG, 0777 );
+      if (out[outs]->fd < 0)
+      {
+	fprintf( stderr, "ERROR: Cannot create %s.\n", name );
+	return E_CREATE;
+      }
+    }
+    i = Extract( out, outs );
+    if (i != E_OK)
+      return i;
+    if (all)
+      printf( "\nThe output images have been saved in: %s*\n", outfile );
+    else
+      printf( "\nThe output image has been saved in: %s\n", outfile );
   }
 
+#ifdef _WIN32
+  CloseHandle( fdin );
+#elif defined( __unix__ )
+  XferClose( &src );
+#else
+  if (fdin)
+    close( fdin );
+#endif
+
+  return 0;
+}
+
+
+// Return the next 32-byte catalog entry, reading the next sector as needed.
+char far* NextEntry( DWORD* sec, UINT* pos, DWORD catalog )
+{
+  if (*pos == 2048)
+  {
+    if (++*sec >= catalog + MAX_CATSEC || !CDReadLong( 1, *sec ))
+      return NULL;
+    *pos = 0;
+  }
+  *pos += 32;
+  return buf + *pos - 32;
+}
+
+
+// Copy a catalog string, dropping trailing spaces.
+void CopyId( char* id, const char far* str, int len )
+{
+  int i;
+
+  for (i = 0; i < len && str[i]; ++i)
+    id[i] = str[i];
+  while (i > 0 && id[i-1] == ' ')
+    --i;
+  id[i] = '\0';
+}
+
+
+void GetEntry( struct entry* e, const char far* ent )
+{
+  e->indicator = ent[0];
+  e->media     = ent[1];
+  e->segment   = *(WORD far*)(ent+2);
+  if (e->segment == 0)
+    e->segment = 0x7c0;
+  e->system    = ent[4];
+  e->count     = *(WORD far*)(ent+6);
+  e->sector    = *(DWORD far*)(ent+8);
+  e->offset    = e->sector;
+  e->size      = e->count;
+}
+
+
+// Read the boot record and catalog, and work out what to extract.
+int Inspect( struct boot* b, int drive )
+{
+  struct entry* order[MAX_ENTRY];
+  struct entry* e;
+  char far* ent;
+  DWORD sec;
+  UINT	pos;
+  int	i, n, last;
+  int	section;
+  BYTE	sec_platform;
+  char	sec_id[29];
+  long	blksize;
+
+  if (!CDReadLong( 1, 0x11 ))
+    return BAD_READ;
+
+  if (_fstrcmp( buf+1, "CD001\01EL TORITO SPECIFICATION" ))
+    return BAD_TORITO;
+  b->catalog = *(DWORD far*)(buf+0x47);
+
+  if (!CDReadLong( 1, b->catalog ))
+    return BAD_READ;
+
   // Just check the key bytes, don't worry about the checksum.
   if (buf[0x1e] != (char)0x55 || buf[0x1f] != (char)0xAA)
+    return BAD_CATALOG;
+  b->platform = buf[1];
+  CopyId( b->id, buf+4, 24 );
+  e = &b->entry[0];
+  e->section  = 0;
+  e->platform = b->platform;
+  *e->id      = '\0';
+  GetEntry( e, buf+0x20 );
+  b->entries = 1;
+
+  // Section headers (0x90, or 0x91 for the last) follow the default entry,
+  // each with its number of section entries, which may have extensions.
+  sec = b->catalog;
+  pos = 0x40;
+  last = 0;
+  section = 0;
+  while (!last && (ent = NextEntry( &sec, &pos, b->catalog )) != NULL)
   {
-    fprintf( stderr, "ERROR: %s has an invalid boot catalog.\n", isofile );
-    return E_NOCD;
-  }
-  type = (BYTE)buf[1];
-  printf( "Platform:\t%s (%02x)\n", (type < 3) ? platform[type] : "unknown",
-				    type );
-  printf( "ID String:\t%.24"SFMT"\n", (buf[4]) ? buf+4 : "not recorded" );
-  printf( "Bootable:\t%s (%02x)\n", (buf[0x20] == (char)0x88) ? "yes" : "no",
-				    (BYTE)buf[0x20] );
-  type = buf[0x21] & 15;
-  printf( "Boot Type:\t%s (%02x)\n", (type < 5) ? boot_type[type] : "unknown",
-				     (BYTE)buf[0x21] );
-  i = *(WORD far*)(buf+0x22);
-  printf( "Load Segment:\t%04x\n", (i == 0) ? 0x7c0 : i );
-  printf( "System Type:\t%02x\n", (BYTE)buf[0x24] );
-  imgsize = *(WORD far*)(buf+0x26);
-  printf( "Sector Count:\t%02x (%d)\n", (UINT)imgsize, (UINT)imgsize );
-  offset = *(DWORD far*)(buf+0x28);
-  printf( "Image Sector:\t%lx\n", offset );
-
-  if (type == 0)		// no emulation
-  {
-    blksize = 0x200;
+    if (ent[0] != (char)0x90 && ent[0] != (char)0x91)
+      break;
+    last = (ent[0] == (char)0x91);
+    ++section;
+    sec_platform = ent[1];
+    CopyId( sec_id, ent+4, 28 );
+    for (n = *(WORD far*)(ent+2); n > 0; --n)
+    {
+      ent = NextEntry( &sec, &pos, b->catalog );
+      if (ent == NULL || (ent[0] != (char)0x88 && ent[0] != 0))
+      {
+	last = 1;
+	break;
+      }
+      if (b->entries < MAX_ENTRY)
+      {
+	e = &b->entry[b->entries++];
+	e->section  = section;
+	e->platform = sec_platform;
+	strcpy( e->id, sec_id );
+	GetEntry( e, ent );
+      }
+      i = ent[1] & 0x20;	// extension follows
+      while (i && (ent = NextEntry( &sec, &pos, b->catalog )) != NULL
+	     && ent[0] == 0x44)
+	i = ent[1] & 0x20;
+    }
   }
-  else
+
+  // Work out the sizes, reading each image in order of its position.
+  SortEntries( b, order );
+  for (i = 0; i < b->entries; ++i)
   {
-    CDReadLong( 1, offset );
-    if (type == 4 && !drive)	// hard disk, keep MBR
+    e = order[i];
+    if ((e->media & 15) == 0)	// no emulation
     {
       blksize = 0x200;
-      imgsize = *(DWORD far*)(buf+0x1ca);
     }
     else
     {
-      if (type == 4)		// hard disk, skip MBR
+      CDReadLong( 1, e->offset );
+      if ((e->media & 15) == 4 && !drive) // hard disk, keep MBR
       {
-	offset += *(DWORD far*)(buf+0x1c6) >> 2;	// diff between HD & CD
-	CDReadLong( 1, offset );
+	blksize = 0x200;
+	e->size = *(DWORD far*)(buf+0x1ca);
+      }
+      else
+      {
+	if ((e->media & 15) == 4)	// hard disk, skip MBR
+	{
+	  e->offset += *(DWORD far*)(buf+0x1c6) >> 2;	// diff between HD & CD
+	  CDReadLong( 1, e->offset );
+	}
+	blksize = *(WORD far*)(buf+11);
+	e->size = *(WORD far*)(buf+19);
+	if (e->size == 0)
+	  e->size = *(DWORD far*)(buf+32);
       }
-      blksize = *(WORD far*)(buf+11);
-      imgsize = *(WORD far*)(buf+19);
-      if (imgsize == 0)
-	imgsize = *(DWORD far*)(buf+32);
     }
+    e->size *= blksize;
   }
-  imgsize *= blksize;
-  printf( "Image Size:\t%ld bytes\n", imgsize );
 
-  if (outfile)
+  return BAD_NONE;
+}
+
+
+// Sort the entries by where they start on the disc (ties by catalog order).
+void SortEntries( const struct boot* b, struct entry** e )
+{
+  struct entry* t;
+  int i, j;
+
+  for (i = 0; i < b->entries; ++i)
+  {
+    t = (struct entry*)&b->entry[i];
+    for (j = i; j > 0 && e[j-1]->offset > t->offset; --j)
+      e[j] = e[j-1];
+    e[j] = t;
+  }
+}
+
+
+const char* PlatformName( BYTE id )
+{
+  return (id < 3) ? platform[id] : (id == PLATFORM_EFI) ? "EFI" : "unknown";
+}
+
+
+void ShowBoot( const struct boot* b )
+{
+  const struct entry* e;
+  int i, type;
+
+  printf( "Catalog Sector:\t%lx\n", (unsigned long)b->catalog );
+  printf( "Platform:\t%s (%02x)\n", PlatformName( b->platform ), b->platform );
+  printf( "ID String:\t%s\n", (*b->id) ? b->id : "not recorded" );
+  for (i = 0; i < b->entries; ++i)
   {
-    fdout = open( outfile, OFLAG, 0777 );
-    if (fdout < 0)
+    e = &b->entry[i];
+    if (i > 0)
     {
-      fprintf( stderr, "ERROR: Cannot create %s.\n", outfile );
-      return E_CREATE;
+      printf( "\nEntry:\t\t%d (section %d)\n", i, e->section );
+      printf( "Platform:\t%s (%02x)\n", PlatformName( e->platform ),
+				       e->platform );
+      if (*e->id)
+	printf( "ID String:\t%s\n", e->id );
     }
+    printf( "Bootable:\t%s (%02x)\n", (e->indicator == 0x88) ? "yes" : "no",
+				      e->indicator );
+    type = e->media & 15;
+    printf( "Boot Type:\t%s (%02x)\n", (type < 5) ? boot_type[type] : "unknown",
+				       e->media );
+    printf( "Load Segment:\t%04x\n", e->segment );
+    printf( "System Type:\t%02x\n", e->system );
+    printf( "Sector Count:\t%02x (%d)\n", e->count, e->count );
+    printf( "Image Sector:\t%lx\n", (unsigned long)e->sector );
+    printf( "Image Size:\t%ld bytes\n", e->size );
+  }
+}
+
 
-    do
+/*
+ * Write the images of the entries (sorted by offset) to their files, reading
+ * the disc once, from start to end: each read is written to every image it
+ * overlaps, so images that share sectors or are adjacent are read together.
+ */
+int Extract( struct entry** e, int cnt )
+{
+  DWORD pos, end, ofs, n;
+  long	len;
+  UINT	w;
+  int	i;
+
+  for (i = 0; i < cnt; ++i)
+  {
+    e[i]->done = 0;
+#ifdef __unix__
+    // Let the kernel copy (or share) as much as it can; do the rest below.
+    e[i]->done = (long)XferCopy( &src, e[i]->fd, e[i]->offset, e[i]->size );
+#endif
+  }
+
+  #define NEXT( e ) ((e)->offset + ((e)->done >> 11))
+  #define END( e )  ((e)->offset + (((e)->size + 2047) >> 11))
+  for (;;)
+  {
+    // Start at the first sector still needed and read to the end of the
+    // image starting there; images starting within are written as we go.
+    pos = ~0;
+    end = 0;
+    for (i = 0; i < cnt; ++i)
     {
-      n = imgsize >> 11;
-      if (n > MAX)
-	n = MAX;
-      else if (n == 0)
-	n = 1;
-      if (!CDReadLong( (UINT)n, offset ))
+      if (e[i]->done == e[i]->size)
+	continue;
+      ofs = NEXT( e[i] );
+      if (ofs < pos)
       {
-	fputs( "Read error!", stderr );
-	return E_ABORTED;
+	pos = ofs;
+	end = 0;
       }
-      len = (UINT)n << 11;
-      if (len > imgsize)
-	len = (UINT)imgsize;
-#ifdef _WIN32
-      w = write( fdout, buf, len );
+      if (ofs == pos && END( e[i] ) > end)
+	end = END( e[i] );
+    }
+    if (end == 0)
+      break;
+
+    n = end - pos;
+    if (n > MAX)
+      n = MAX;
+    if (!CDReadLong( (UINT)n, pos ))
+    {
+      fputs( "Read error!", stderr );
+      return E_ABORTED;
+    }
+
+    for (i = 0; i < cnt; ++i)
+    {
+      ofs = NEXT( e[i] );
+      if (e[i]->done == e[i]->size || ofs < pos || ofs >= pos + n)
+	continue;
+      len = (long)(pos + n - ofs) << 11;
+      if (len > e[i]->size - e[i]->done)
+	len = e[i]->size - e[i]->done;
+#if defined( _WIN32 ) || defined( __unix__ )
+      w = write( e[i]->fd, buf + ((UINT)(ofs - pos) << 11), (UINT)len );
 #else
-      _dos_write( fdout, buf, len, &w );
+      _dos_write( e[i]->fd, buf + ((UINT)(ofs - pos) << 11), (UINT)len, &w );
 #endif
-      if (w != len)
+      if (w != (UINT)len)
       {
 	fputs( "Write error!", stderr );
 	return E_ABORTED;
       }
-      offset += n;
-      imgsize -= len;
-    } while (imgsize);
-    close( fdout );
-    printf( "\nThe output image has been saved in: %s\n", outfile );
+      e[i]->done += len;
+    }
   }
 
-#ifdef _WIN32
-  CloseHandle( fdin );
-#else
-  if (fdin)
-    close( fdin );
-#endif
+  for (i = 0; i < cnt; ++i)
+    close( e[i]->fd );
 
-  return 0;
+  return E_OK;
 }
 
 
@@ -401,6 +776,10 @@ int CDReadLong( UINT SectorCount, DWORD StartSector )
   pos += len;
   return (len == (SectorCount << 11));
 
+#elif defined( __unix__ )
+  (void)pos, (void)ofs;
+  return XferRead( &src, buf, SectorCount, StartSector );
+
 #else
   struct REGPACK regs;
   WORD len;
@@ -428,3 +807,257 @@ int CDReadLong( UINT SectorCount, DWORD StartSector )
 
 #endif
 }
+
+
+#ifdef __unix__
+/*
+ * Batch mode: inspect every image named on the command line or in a list
+ * (directories are searched for ".iso" files), with several threads reading
+ * images at once, then list them all (in the order found) as CSV or JSON.
+ */
+
+struct scan
+{
+  char* name;
+  int	bad;		// BAD_*
+  struct boot b;
+} *scan;
+int  scans, scan_max, scan_next;
+int  scan_drive;
+pthread_mutex_t scan_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+int AddScan( const char* name )
+{
+  if (scans == scan_max)
+  {
+    scan_max = (scan_max) ? scan_max * 2 : 256;
+    scan = realloc( scan, scan_max * sizeof(struct scan) );
+    if (scan == NULL)
+    {
+      fputs( "ERROR: Not enough memory.\n", stderr );
+      exit( E_MEM );
+    }
+  }
+  scan[scans].name = strdup( name );
+  scan[scans].bad  = BAD_OPEN;
+  ++scans;
+
+  return 0;
+}
+
+
+int AddFound( const char* name, const struct stat* st, int flag,
+	      struct FTW* ftw )
+{
+  const char* dot;
+
+  (void)st, (void)ftw;
+  if (flag == FTW_F)
+  {
+    dot = strrchr( name, '.' );
+    if (dot && strcasecmp( dot, ".iso" ) == 0)
+      AddScan( name );
+  }
+  return 0;
+}
+
+
+void AddPath( const char* name )
+{
+  struct stat st;
+
+  if (stat( name, &st ) == 0 && S_ISDIR( st.st_mode ))
+    nftw( name, AddFound, 16, FTW_PHYS );
+  else
+    AddScan( name );
+}
+
+
+void* ScanThread( void* arg )
+{
+  int i;
+
+  (void)arg;
+  buf = malloc( 2048 );
+  if (buf == NULL)
+    return NULL;
+  for (;;)
+  {
+    pthread_mutex_lock( &scan_lock );
+    i = scan_next++;
+    pthread_mutex_unlock( &scan_lock );
+    if (i >= scans)
+      break;
+    if (XferOpen( &src, scan[i].name, 1 ))
+    {
+      scan[i].bad = Inspect( &scan[i].b, scan_drive );
+      XferClose( &src );
+    }
+  }
+  free( buf );
+
+  return NULL;
+}
+
+
+// Write a string as a CSV field or JSON string.  JSON is UTF-8, so only the
+// control characters need escaping; other bytes (names) go out as they are.
+void PutStr( const char* str, int json )
+{
+  const BYTE* s = (const BYTE*)str;
+
+  if (!json && strpbrk( str, ",\"\n\r" ) == NULL)
+  {
+    fputs( str, stdout );
+    return;
+  }
+  putchar( '"' );
+  for (; *s; ++s)
+  {
+    if (*s == '"')
+      fputs( (json) ? "\\\"" : "\"\"", stdout );
+    else if (json && *s == '\\')
+      fputs( "\\\\", stdout );
+    else if (json && *s < 32)
+      printf( "\\u%04x", *s );
+    else
+      putchar( *s );
+  }
+  putchar( '"' );
+}
+
+
+void ListScan( const struct scan* sc, int json, int first )
+{
+  const struct boot*  b = &sc->b;
+  const struct entry* e;
+  int i, type;
+
+  if (json)
+  {
+    fputs( (first) ? "[\n  {\"file\":" : ",\n  {\"file\":", stdout );
+    PutStr( sc->name, 1 );
+    if (sc->bad)
+    {
+      fputs( ",\"error\":", stdout );
+      PutStr( bad_msg[sc->bad], 1 );
+      putchar( '}' );
+      return;
+    }
+    printf( ",\"catalog_sector\":%lu,\"platform\":",
+	    (unsigned long)b->catalog );
+    PutStr( PlatformName( b->platform ), 1 );
+    fputs( ",\"id\":", stdout );
+    PutStr( b->id, 1 );
+    fputs( ",\"entries\":[", stdout );
+    for (i = 0; i < b->entries; ++i)
+    {
+      e = &b->entry[i];
+      type = e->media & 15;
+      printf( "%s\n    {\"entry\":%d,\"section\":%d,\"platform\":",
+	      (i) ? "," : "", i, e->section );
+      PutStr( PlatformName( e->platform ), 1 );
+      fputs( ",\"id\":", stdout );
+      PutStr( (i) ? e->id : b->id, 1 );
+      printf( ",\"bootable\":%s,\"boot_type\":",
+	      (e->indicator == 0x88) ? "true" : "false" );
+      PutStr( (type < 5) ? boot_type[type] : "unknown", 1 );
+      printf( ",\"load_segment\":\"%04x\",\"system_type\":%u,"
+	      "\"sector_count\":%u,\"image_sector\":%lu,\"image_size\":%ld}",
+	      e->segment, e->system, e->count, (unsigned long)e->sector,
+	      e->size );
+    }
+    fputs( "]}", stdout );
+    return;
+  }
+
+  if (first)
+    puts( "File,Entry,Section,Catalog Sector,Platform,ID String,Bootable,"
+	  "Boot Type,Load Segment,System Type,Sector Count,Image Sector,"
+	  "Image Size,Error" );
+  if (sc->bad)
+  {
+    PutStr( sc->name, 0 );
+    fputs( ",,,,,,,,,,,,,", stdout );
+    puts( bad_msg[sc->bad] );
+    return;
+  }
+  for (i = 0; i < b->entries; ++i)
+  {
+    e = &b->entry[i];
+    type = e->media & 15;
+    PutStr( sc->name, 0 );
+    printf( ",%d,%d,%lu,", i, e->section, (unsigned long)b->catalog );
+    PutStr( PlatformName( e->platform ), 0 );
+    putchar( ',' );
+    PutStr( (i) ? e->id : b->id, 0 );
+    printf( ",%s,%s,%04x,%u,%u,%lu,%ld,\n",
+	    (e->indicator == 0x88) ? "yes" : "no",
+	    (type < 5) ? boot_type[type] : "unknown",
+	    e->segment, e->system, e->count, (unsigned long)e->sector, e->size );
+  }
+}
+
+
+int Batch( char** paths, int cnt, const char* list, int json, int threads,
+	   int drive )
+{
+  pthread_t* tid;
+  FILE* file;
+  char	line[1024];
+  int	i, len;
+
+  for (i = 0; i < cnt; ++i)
+    AddPath( paths[i] );
+  if (list)
+  {
+    file = (strcmp( list, "-" ) == 0) ? stdin : fopen( list, "r" );
+    if (file == NULL)
+    {
+      fprintf( stderr, "ERROR: Cannot open %s.\n", list );
+      return E_NOCD;
+    }
+    while (fgets( line, sizeof(line), file ))
+    {
+      len = strlen( line );
+      while (len && (line[len-1] == '\n' || line[len-1] == '\r'))
+	line[--len] = '\0';
+      if (len)
+	AddPath( line );
+    }
+    if (file != stdin)
+      fclose( file );
+  }
+
+  if (threads <= 0)
+    threads = sysconf( _SC_NPROCESSORS_ONLN );
+  if (threads > scans)
+    threads = scans;
+  if (threads < 1)
+    threads = 1;
+  scan_drive = drive;
+  tid = malloc( threads * sizeof(pthread_t) );
+  if (tid == NULL)
+  {
+    fputs( "ERROR: Not enough memory.\n", stderr );
+    return E_MEM;
+  }
+  for (i = 0; i < threads; ++i)
+  {
+    if (pthread_create( &tid[i], NULL, ScanThread, NULL ))
+      break;
+  }
+  if (i == 0)			// no threads, so do it here
+    ScanThread( NULL );
+  while (--i >= 0)
+    pthread_join( tid[i], NULL );
+
+  for (i = 0; i < scans; ++i)
+    ListScan( &scan[i], json, (i == 0) );
+  if (json)
+    puts( (scans) ? "\n]" : "[]" );
+
+  return E_OK;
+}
+#endif
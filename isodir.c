@@ -0,0 +1,501 @@
+/*
+ * isodir.c: Read the directories of an ISO 9660, High Sierra or Joliet CD.
+ *
+ * The name handling follows SHSUCDX (ToFCB, FCBCopy, Match and FindName):
+ *
+ * - names are uppercased and stop at '.', ';' or NUL; a leading dot is
+ *   ignored; the first eight characters are the name, the first three after
+ *   the dot the extension;
+ * - a name with more than eight or three characters is long and (if tildes
+ *   are wanted) gets "~n" at the end of its name part;
+ * - n is the record's position in the directory, counting from 0 and
+ *   restarting at the next multiple of 64 with each sector (so inserting a
+ *   file only changes the aliases of the sector it went into); associated
+ *   files are ignored and not counted.
+ *
+ * SHSUCDX has DOSLFN convert Joliet names to the OEM code page. That can't be
+ * done here, so characters beyond ASCII become '_' before the conversion.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __unix__
+#include <sys/types.h>
+#endif
+#include "isodir.h"
+
+#define VD_START  16		// first volume descriptor
+#define VD_MAX	  64		// give up looking for Joliet after this many
+
+#define LE16( p ) ((p)[0] | ((unsigned)(p)[1] << 8))
+#define LE32( p ) ((p)[0] | ((unsigned long)(p)[1] << 8) | \
+		   ((unsigned long)(p)[2] << 16) | ((unsigned long)(p)[3] << 24))
+
+// Directory record
+#define DR_EXTENT  2
+#define DR_SIZE    10
+#define DR_DATE    18
+#define DR_FLAGS   25		// one less for High Sierra (no GMT offset)
+#define DR_IDLEN   32
+#define DR_ID	   33
+
+
+// Return the next character, setting *cx to zero at the end of the name.
+static int term( const unsigned char** p, unsigned long* cx )
+{
+  int c = *(*p)++;
+
+  if (c == ';' || c == 0)
+    *cx = 0;
+  return c;
+}
+
+#define TERM( c ) ((c) == '.' || (c) == ';' || (c) == 0)
+
+
+// Copy up to max characters, uppercased. Returns 1 if it stopped at a dot.
+static int fcb_copy( const unsigned char** p, unsigned long* cx, char* fcb,
+		     int max )
+{
+  int c;
+
+  do
+  {
+    c = term( p, cx );
+    if (c == '.')
+      return 1;
+    if (TERM( c ))
+      return 0;
+    *fcb++ = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+    --max;
+    --*cx;
+  } while (max && *cx);
+
+  return 0;
+}
+
+
+// Convert a name to FCB form. If len is zero the name is NUL-terminated. If
+// alias is not zero and the name is long, "~alias" ends the name part.
+// Eg: "readme.html", 1 ==> "README~1HTM".
+void IsoToFCB( const char* name, unsigned len, unsigned alias, char* fcb )
+{
+  const unsigned char* p = (const unsigned char*)name;
+  unsigned long cx = len ? len : ~0ul;
+  int	long_name = 0;
+  int	c;
+  char	digit[5];
+  int	n;
+  char* bx;
+
+  memset( fcb, ' ', 11 );
+  if (*p <= 1)			// current and parent directories
+  {
+    fcb[0] = '.';
+    if (*p == 1)
+      fcb[1] = '.';
+    return;
+  }
+
+  if (*p == '.')		// ignore a leading dot (no name portion)
+    ++p, --cx;
+  if (!fcb_copy( &p, &cx, fcb, 8 ))
+  {
+    if (cx == 0)
+      return;
+    for (;;)			// skip the remaining name characters
+    {
+      c = term( &p, &cx );
+      if (c == '.')
+	goto ext;
+      if (TERM( c ))
+	break;
+      long_name = 1;
+      if (--cx == 0)
+	break;
+    }
+    ++cx;
+  }
+
+ext:
+  if (--cx != 0)
+    fcb_copy( &p, &cx, fcb + 8, 3 );
+
+  if (!long_name)
+  {
+    if (cx == 0)
+      return;
+    c = term( &p, &cx );
+    if (TERM( c ))
+      return;
+  }
+
+  if (alias == 0)
+    return;
+  n = 0;
+  do
+    digit[n++] = '0' + alias % 10;
+  while (alias /= 10);
+  bx = fcb + 8 - n - 1;
+  while (bx > fcb && bx[-1] == ' ')
+    --bx;
+  *bx = '~';
+  while (n)
+    *++bx = digit[--n];
+}
+
+
+// Convert a record's name to FCB form, as SHSUCDX would display it.
+void IsoFCB( const struct iso_vol* v, const struct iso_rec* r, char* fcb )
+{
+  char	   name[128];
+  unsigned alias = v->tildes ? r->alias : 0;
+  unsigned i, c;
+
+  if (!r->ucs2)
+  {
+    IsoToFCB( (const char*)r->name, r->len, alias, fcb );
+    return;
+  }
+
+  for (i = 0; i < r->len / 2 && i < sizeof(name); ++i)
+  {
+    c = (r->name[i*2] << 8) | r->name[i*2+1];
+    name[i] = (c < 0x80) ? c : '_';
+  }
+  IsoToFCB( name, i, alias, fcb );
+}
+
+
+// Match an FCB name against a template, where '?' matches anything.
+int IsoMatch( const char* tmpl, const char* fcb )
+{
+  int i;
+
+  for (i = 0; i < 11; ++i)
+    if (tmpl[i] != '?' && tmpl[i] != fcb[i])
+      return 0;
+
+  return 1;
+}
+
+
+// DOS attribute of a record; files are read-only if ro.
+int IsoAttr( const struct iso_rec* r, int ro )
+{
+  int attr = (r->flags & ISO_HIDDEN) ? 0x02 : 0;
+
+  if (r->flags & ISO_DIR)
+    attr |= 0x10;
+  else if (ro)
+    attr |= 0x01;
+
+  return attr;
+}
+
+
+// DOS date (high word) and time of a record.
+unsigned long IsoDosTime( const struct iso_rec* r )
+{
+  const unsigned char* d = r->date;
+  unsigned yr;
+
+  if (d == NULL)
+    return 0;
+  yr = (d[0] < 80) ? 0 : d[0] - 80;	// ISO is from 1900, DOS is from 1980
+
+  return ((unsigned long)((yr << 9) | (d[1] << 5) | d[2]) << 16)
+	 | (d[3] << 11) | (d[4] << 5) | (d[5] >> 1);
+}
+
+
+// Read the volume descriptors, preferring Joliet if wanted and present.
+// Returns the type of volume (ISO_NONE if it isn't a CD or can't be read).
+// Tildes are off, as they are in SHSUCDX by default.
+int IsoOpen( struct iso_vol* v, iso_read read, void* ctx, int joliet )
+{
+  const unsigned char* vd;
+  const unsigned char* root;
+  unsigned long sector;
+  int i;
+
+  memset( v, 0, sizeof(*v) );
+  v->read = read;
+  v->ctx  = ctx;
+
+  vd = read( ctx, VD_START );
+  if (vd == NULL)
+    return ISO_NONE;
+  if (memcmp( vd + 9, "CDROM", 5 ) == 0)
+  {
+    v->type = ISO_HSF;
+    memcpy( v->label, vd + 48, 11 );
+    v->size	   = LE32( vd + 88 );
+    v->ptable_size = LE32( vd + 140 );
+    v->ptable	   = LE32( vd + 148 );
+    root = vd + 180;
+  }
+  else if (memcmp( vd + 1, "CD001", 5 ) == 0)
+  {
+    v->type = ISO_9660;
+    memcpy( v->label, vd + 40, 11 );
+    v->size	   = LE32( vd + 80 );
+    v->ptable_size = LE32( vd + 132 );
+    v->ptable	   = LE32( vd + 140 );
+    root = vd + 156;
+  }
+  else
+    return ISO_NONE;
+  v->root      = LE32( root + DR_EXTENT );
+  v->root_size = LE32( root + DR_SIZE );
+  for (i = 11; i > 0 && v->label[i-1] == ' '; --i)
+    v->label[i-1] = '\0';
+
+  if (joliet && v->type == ISO_9660)
+  {
+    for (sector = VD_START + 1; sector < VD_START + VD_MAX; ++sector)
+    {
+      vd = read( ctx, sector );
+      if (vd == NULL || vd[0] == 255 || memcmp( vd + 1, "CD001", 5 ) != 0)
+	break;
+      if (vd[0] == 2 && vd[88] == '%' && vd[89] == '/'
+	  && (vd[90] == '@' || vd[90] == 'C' || vd[90] == 'E'))
+      {
+	v->type        = ISO_JOLIET;
+	v->ptable_size = LE32( vd + 132 );
+	v->ptable      = LE32( vd + 140 );
+	v->root        = LE32( vd + 156 + DR_EXTENT );
+	v->root_size   = LE32( vd + 156 + DR_SIZE );
+	break;
+      }
+    }
+  }
+
+  return v->type;
+}
+
+
+void IsoRoot( const struct iso_vol* v, struct iso_rec* r )
+{
+  memset( r, 0, sizeof(*r) );
+  r->name   = (const unsigned char*)"";
+  r->flags  = ISO_DIR;
+  r->extent = v->root;
+  r->size   = v->root_size;
+}
+
+
+// Prepare to read the directory r (which need not remain valid).
+int IsoOpenDir( struct iso_vol* v, struct iso_dir* d, const struct iso_rec* r )
+{
+  if (!(r->flags & ISO_DIR))
+    return 0;
+
+  d->vol    = v;
+  d->buf    = NULL;
+  d->sector = r->extent;
+  d->left   = (r->size + ISO_SECTOR - 1) / ISO_SECTOR;
+  d->pos    = 0;
+  d->alias  = 0;
+
+  return 1;
+}
+
+
+// Get the next record of the directory. Returns 1 if there is one, 0 at the
+// end of the directory and -1 if a sector could not be read.
+int IsoNext( struct iso_dir* d, struct iso_rec* r )
+{
+  const unsigned char* rec;
+  unsigned len;
+  int	   flags;
+  int	   hsf = (d->vol->type == ISO_HSF);
+
+  for (;;)
+  {
+    if (d->buf == NULL || d->pos > ISO_SECTOR - DR_ID || d->buf[d->pos] == 0)
+    {
+      if (d->left == 0)
+	return 0;
+      if (d->buf != NULL)
+      {
+	++d->sector;
+	d->alias = (d->alias & ~63u) + 64;
+      }
+      d->buf = d->vol->read( d->vol->ctx, d->sector );
+      if (d->buf == NULL)
+	return -1;
+      --d->left;
+      d->pos = 0;
+      continue;
+    }
+
+    rec = d->buf + d->pos;
+    len = rec[0];
+    if (len <= DR_ID || d->pos + len > ISO_SECTOR
+	|| DR_ID + (unsigned)rec[DR_IDLEN] > len)
+    {
+      d->pos = ISO_SECTOR;	// corrupt, try the next sector
+      continue;
+    }
+    d->pos += len;
+
+    flags = rec[DR_FLAGS - hsf];
+    if (flags & ISO_ASSOC)
+      continue;
+
+    r->rec    = rec;
+    r->name   = rec + DR_ID;
+    r->len    = rec[DR_IDLEN];
+    r->ucs2   = (d->vol->type == ISO_JOLIET && r->name[0] < 0x30
+		 && !(r->len & 1));
+    r->flags  = flags;
+    r->extent = LE32( rec + DR_EXTENT );
+    r->size   = LE32( rec + DR_SIZE );
+    r->date   = rec + DR_DATE;
+    r->alias  = d->alias++;
+    return 1;
+  }
+}
+
+
+// Find the next record matching the FCB template (which may contain '?'),
+// returning its FCB name in fcb (if not NULL). Returns as IsoNext.
+int IsoFind( struct iso_dir* d, const char* tmpl, struct iso_rec* r,
+	     char* fcb )
+{
+  char name[11];
+  int  rc;
+
+  if (fcb == NULL)
+    fcb = name;
+  while ((rc = IsoNext( d, r )) == 1)
+  {
+    IsoFCB( d->vol, r, fcb );
+    if (IsoMatch( tmpl, fcb ))
+      break;
+  }
+
+  return rc;
+}
+
+
+// Find the record of a path ('\' or '/' separated), as SHSUCDX would given
+// the same path. Returns as IsoNext; r is only valid until the next read.
+int IsoLookup( struct iso_vol* v, const char* path, struct iso_rec* r )
+{
+  struct iso_dir d;
+  const char* end;
+  char tmpl[11];
+  int  rc;
+
+  IsoRoot( v, r );
+  for (;;)
+  {
+    while (*path == '\\' || *path == '/')
+      ++path;
+    if (*path == '\0')
+      return 1;
+    for (end = path; *end && *end != '\\' && *end != '/'; ++end) ;
+    IsoToFCB( path, end - path, 0, tmpl );
+    if (!IsoOpenDir( v, &d, r ))
+      return 0;
+    rc = IsoFind( &d, tmpl, r, NULL );
+    if (rc != 1)
+      return rc;
+    path = end;
+  }
+}
+
+
+// Read the path table. Returns 0 if it could not be read.
+int IsoOpenPath( struct iso_vol* v, struct iso_path* p )
+{
+  const unsigned char* sec;
+  unsigned long ofs, n;
+
+  memset( p, 0, sizeof(*p) );
+  p->type = v->type;
+  p->num  = 1;
+  if (v->ptable_size == 0)
+    return 0;
+  p->buf = malloc( v->ptable_size );
+  if (p->buf == NULL)
+    return 0;
+  p->size = v->ptable_size;
+
+  for (ofs = 0; ofs < p->size; ofs += n)
+  {
+    sec = v->read( v->ctx, v->ptable + ofs / ISO_SECTOR );
+    if (sec == NULL)
+    {
+      IsoClosePath( p );
+      return 0;
+    }
+    n = p->size - ofs;
+    if (n > ISO_SECTOR)
+      n = ISO_SECTOR;
+    memcpy( p->buf + ofs, sec, n );
+  }
+
+  return 1;
+}
+
+
+// Get the next path table entry. Returns 0 at the end of the table.
+int IsoNextPath( struct iso_path* p, struct iso_pent* e )
+{
+  const unsigned char* ent;
+  unsigned len;
+
+  if (p->buf == NULL || p->pos + 8 > p->size)
+    return 0;
+  ent = p->buf + p->pos;
+  if (p->type == ISO_HSF)
+  {
+    e->extent = LE32( ent );
+    len = ent[5];
+  }
+  else
+  {
+    e->extent = LE32( ent + 2 );
+    len = ent[0];
+  }
+  if (len == 0 || p->pos + 8 + len > p->size)
+    return 0;
+  e->parent = LE16( ent + 6 );
+  e->name   = ent + 8;
+  e->len    = (p->num == 1) ? 0 : len;
+  e->ucs2   = (p->type == ISO_JOLIET && e->len && e->name[0] < 0x30
+	       && !(len & 1));
+  e->num    = p->num++;
+  p->pos   += 8 + len + (len & 1);
+
+  return 1;
+}
+
+
+void IsoClosePath( struct iso_path* p )
+{
+  free( p->buf );
+  p->buf = NULL;
+}
+
+
+// iso_read for a stdio file (ctx is a struct iso_file with f opened "rb").
+const unsigned char* IsoReadFile( void* ctx, unsigned long sector )
+{
+  struct iso_file* f = ctx;
+
+#ifdef __unix__
+  if (fseeko( f->f, (off_t)sector * ISO_SECTOR, SEEK_SET ) != 0
+#else
+  if (fseek( f->f, (long)sector * ISO_SECTOR, SEEK_SET ) != 0
+#endif
+      || fread( f->buf, ISO_SECTOR, 1, f->f ) != 1)
+    return NULL;
+  f->sector = sector;
+
+  return f->buf;
+}
@@ -0,0 +1,116 @@
+/*
+ * isodir.h: Read the directories of an ISO 9660, High Sierra or Joliet CD.
+ *
+ * This is SHSUCDX's directory handling for programs running on the host.
+ * Names are converted to the same blank-padded 8+3 (FCB) form, with the same
+ * "~n" aliases for long names, so a name or wildcard given to SHSUCDX finds
+ * the same file here.
+ *
+ * Nothing is allocated (other than the path table, which may span sectors):
+ * sectors come from the caller's read function and records are returned as
+ * pointers into them, which remain valid until the next sector is read.
+ */
+
+#ifndef ISODIR_H
+#define ISODIR_H
+
+#define ISO_SECTOR 2048
+
+enum { ISO_NONE, ISO_HSF, ISO_9660, ISO_JOLIET };	// volume types
+
+// Directory record flags
+#define ISO_HIDDEN    0x01
+#define ISO_DIR       0x02
+#define ISO_ASSOC     0x04
+
+// Return a pointer to the sector, valid at least until the next call (a
+// mapped image would never change it); NULL if it could not be read.
+typedef const unsigned char* (*iso_read)( void* ctx, unsigned long sector );
+
+struct iso_vol
+{
+  iso_read	read;
+  void* 	ctx;
+  int		type;		// ISO_*
+  int		tildes; 	// add the alias to long names (SHSUCDX /~)
+  unsigned long size;		// sectors in the volume
+  unsigned long root;		// first sector of the root directory
+  unsigned long root_size;	// and its length in bytes
+  unsigned long ptable; 	// first sector of the (little-endian) path
+  unsigned long ptable_size;	//  table and its length in bytes
+  char		label[12];	// volume label (from the primary descriptor)
+};
+
+struct iso_dir
+{
+  struct iso_vol* vol;
+  const unsigned char* buf;	// the current sector
+  unsigned long sector; 	// its number
+  unsigned long left;		// sectors remaining after it
+  unsigned	pos;		// offset of the next record
+  unsigned	alias;		// number of the next record
+};
+
+struct iso_rec
+{
+  const unsigned char* rec;	// the record (NULL for the root)
+  const unsigned char* name;	// its identifier
+  unsigned	len;		// length of the identifier
+  int		ucs2;		// identifier is Joliet (big-endian UCS-2)
+  int		flags;		// ISO_HIDDEN, ISO_DIR
+  unsigned long extent; 	// first sector
+  unsigned long size;		// length in bytes
+  const unsigned char* date;	// year - 1900, month, day, hour, min, sec
+  unsigned	alias;		// SHSUCDX's alias number
+};
+
+struct iso_path
+{
+  unsigned char* buf;		// the entire path table
+  unsigned long size;
+  unsigned long pos;		// offset of the next entry
+  unsigned	num;		// number of the next entry (from 1)
+  int		type;
+};
+
+struct iso_pent
+{
+  const unsigned char* name;	// identifier (empty for the root)
+  unsigned	len;
+  int		ucs2;
+  unsigned long extent; 	// directory's first sector
+  unsigned	parent; 	// number of the parent entry
+  unsigned	num;		// number of this entry
+};
+
+// Simple sector reader using stdio, for iso_read.
+struct iso_file
+{
+  void* 	f;		// FILE*
+  unsigned long sector;
+  unsigned char buf[ISO_SECTOR];
+};
+
+int	IsoOpen( struct iso_vol* v, iso_read read, void* ctx, int joliet );
+
+void	IsoRoot( const struct iso_vol* v, struct iso_rec* r );
+int	IsoOpenDir( struct iso_vol* v, struct iso_dir* d,
+		    const struct iso_rec* r );
+int	IsoNext( struct iso_dir* d, struct iso_rec* r );
+int	IsoFind( struct iso_dir* d, const char* tmpl, struct iso_rec* r,
+		 char* fcb );
+int	IsoLookup( struct iso_vol* v, const char* path, struct iso_rec* r );
+
+void	IsoToFCB( const char* name, unsigned len, unsigned alias, char* fcb );
+void	IsoFCB( const struct iso_vol* v, const struct iso_rec* r, char* fcb );
+int	IsoMatch( const char* tmpl, const char* fcb );
+int	IsoAttr( const struct iso_rec* r, int ro );
+unsigned long IsoDosTime( const struct iso_rec* r );
+
+int	IsoOpenPath( struct iso_vol* v, struct iso_path* p );
+int	IsoNextPath( struct iso_path* p, struct iso_pent* e );
+void	IsoClosePath( struct iso_path* p );
+
+const unsigned char* IsoReadFile( void* ctx, unsigned long sector );
+
+#endif
@@ -0,0 +1,416 @@
+/*
+ * mkbench.c: Make the CD image used by CDBENCH.
+ *
+ * Writes a plain ISO 9660 image (8.3 names, no Joliet) whose contents are
+ * fixed, so every run of the benchmark reads exactly the same disc:
+ *
+ *	\BIG.DAT		32MiB, for the sequential and random reads
+ *	\FILES\F0000.DAT	1000 small files (512 bytes to 4Ki) in the one
+ *	  ...			 directory, for the opens
+ *	\TREE\D0\D0\D0		three levels of six directories, each with
+ *	  ...			 a few files, for the walk
+ *
+ * The data is pseudo-random, so nothing along the way can compress it.
+ *
+ * Build with MAKEFILE.LNX.
+ */
+
+#define PVERS "1.00"
+#define PDATE "17 October, 2026"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTOR	  2048
+#define BIGSIZE   (32L << 20)
+#define SMALLS	  1000
+#define FANOUT	  6
+#define LEVELS	  3
+#define TREEFILES 3
+
+#define MAXDIRS   (2 + FANOUT + FANOUT*FANOUT + FANOUT*FANOUT*FANOUT + 1)
+#define MAXFILES  (1 + SMALLS + MAXDIRS * TREEFILES)
+
+// Recording date of everything: 17 October, 2026, 00:00:00 GMT.
+static const unsigned char rec_date[7] = { 126, 10, 17, 0, 0, 0, 0 };
+static const char vol_date[17] = "2026101700000000";
+
+struct file
+{
+  char		name[13];
+  unsigned long size;
+  unsigned long extent;
+};
+
+struct dir
+{
+  char		name[9];
+  int		parent; 	// index into dirs (root is its own parent)
+  int		level;
+  int		first, last;	// subdirectories, in dirs
+  int		ffirst, flast;	// files, in files
+  unsigned long size;		// bytes of records, rounded to sectors
+  unsigned long extent;
+};
+
+struct dir  dirs[MAXDIRS];
+struct file files[MAXFILES];
+int	    ndirs, nfiles;
+
+unsigned long seed = 1;
+
+unsigned random8( void )
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0xff;
+}
+
+
+void put16( unsigned char* p, unsigned n )
+{
+  p[0] = n;
+  p[1] = n >> 8;
+}
+
+void put32( unsigned char* p, unsigned long n )
+{
+  p[0] = n;
+  p[1] = n >> 8;
+  p[2] = n >> 16;
+  p[3] = n >> 24;
+}
+
+void put32m( unsigned char* p, unsigned long n )
+{
+  p[0] = n >> 24;
+  p[1] = n >> 16;
+  p[2] = n >> 8;
+  p[3] = n;
+}
+
+// Both-endian values.
+void put16b( unsigned char* p, unsigned n )
+{
+  put16( p, n );
+  p[2] = n >> 8;
+  p[3] = n;
+}
+
+void put32b( unsigned char* p, unsigned long n )
+{
+  put32( p, n );
+  put32m( p + 4, n );
+}
+
+
+unsigned long sectors( unsigned long bytes )
+{
+  return (bytes + SECTOR - 1) / SECTOR;
+}
+
+
+// Add a directory, returning its index.  Subdirectories of a directory must
+// be added together, in order, as the path table is written in the order the
+// directories were added.
+int add_dir( const char* name, int parent )
+{
+  struct dir* d = &dirs[ndirs];
+
+  strcpy( d->name, name );
+  d->parent = parent;
+  d->level  = (ndirs == 0) ? 1 : dirs[parent].level + 1;
+  d->first  = d->last = 0;
+  d->ffirst = d->flast = 0;
+  if (ndirs != 0)
+  {
+    if (dirs[parent].first == 0)
+      dirs[parent].first = ndirs;
+    dirs[parent].last = ndirs + 1;
+  }
+  return ndirs++;
+}
+
+void add_file( int dir, const char* name, unsigned long size )
+{
+  if (dirs[dir].ffirst == dirs[dir].flast)
+    dirs[dir].ffirst = nfiles;
+  strcpy( files[nfiles].name, name );
+  files[nfiles].size = size;
+  dirs[dir].flast = ++nfiles;
+}
+
+
+// Directory record length for a name of len characters.
+int rec_len( int len )
+{
+  return (33 + len + 1) & ~1;
+}
+
+// Write a directory record, returning its length.
+int make_rec( unsigned char* p, const char* name, int len,
+	      unsigned long extent, unsigned long size, int dir )
+{
+  int rlen = rec_len( len );
+
+  memset( p, 0, rlen );
+  p[0] = rlen;
+  put32b( p + 2, extent );
+  put32b( p + 10, size );
+  memcpy( p + 18, rec_date, 7 );
+  p[25] = dir ? 2 : 0;
+  put16b( p + 28, 1 );
+  p[32] = len;
+  memcpy( p + 33, name, len );
+  return rlen;
+}
+
+// The records of a directory: ".", "..", then the subdirectories and files
+// (which must all be in sorted order).  Returns the size, rounded up to whole
+// sectors, writing the records into buf if it's not NULL.
+unsigned long dir_records( int n, unsigned char* buf )
+{
+  struct dir* d = &dirs[n];
+  unsigned long pos = 0;
+  unsigned char rec[64];
+  char	 name[16];
+  int	 i, len, s, f;
+
+  for (i = -2, s = d->first, f = d->ffirst;; ++i)
+  {
+    if (i == -2)
+      len = make_rec( rec, "\0", 1, d->extent, d->size, 1 );
+    else if (i == -1)
+      len = make_rec( rec, "\1", 1, dirs[d->parent].extent,
+				    dirs[d->parent].size, 1 );
+    else if (s < d->last && (f == d->flast ||
+			     strcmp( dirs[s].name, files[f].name ) < 0))
+    {
+      len = make_rec( rec, dirs[s].name, strlen( dirs[s].name ),
+		      dirs[s].extent, dirs[s].size, 1 );
+      ++s;
+    }
+    else if (f < d->flast)
+    {
+      sprintf( name, "%s;1", files[f].name );
+      len = make_rec( rec, name, strlen( name ),
+		      files[f].extent, files[f].size, 0 );
+      ++f;
+    }
+    else
+      break;
+    // Records can't cross a sector boundary.
+    if (pos / SECTOR != (pos + len - 1) / SECTOR)
+    {
+      if (buf != NULL)
+	memset( buf + pos, 0, SECTOR - pos % SECTOR );
+      pos += SECTOR - pos % SECTOR;
+    }
+    if (buf != NULL)
+      memcpy( buf + pos, rec, len );
+    pos += len;
+  }
+  if (buf != NULL && pos % SECTOR)
+    memset( buf + pos, 0, SECTOR - pos % SECTOR );
+  return sectors( pos ) * SECTOR;
+}
+
+
+// Path table, little-endian (type L) or big-endian (type M).
+unsigned long path_table( unsigned char* buf, int big )
+{
+  unsigned long pos = 0;
+  int	i, len;
+
+  for (i = 0; i < ndirs; ++i)
+  {
+    len = (i == 0) ? 1 : strlen( dirs[i].name );
+    if (buf != NULL)
+    {
+      unsigned char* p = buf + pos;
+      p[0] = len;
+      p[1] = 0;
+      if (big)
+      {
+	put32m( p + 2, dirs[i].extent );
+	p[6] = (dirs[i].parent + 1) >> 8;
+	p[7] = dirs[i].parent + 1;
+      }
+      else
+      {
+	put32( p + 2, dirs[i].extent );
+	put16( p + 6, dirs[i].parent + 1 );
+      }
+      memcpy( p + 8, (i == 0) ? "\0" : dirs[i].name, len );
+      if (len & 1)
+	p[8 + len] = 0;
+    }
+    pos += 8 + len + (len & 1);
+  }
+  return pos;
+}
+
+
+void pad( char* p, const char* s, int len )
+{
+  memset( p, ' ', len );
+  memcpy( p, s, strlen( s ) );
+}
+
+void make_pvd( unsigned char* p, unsigned long vol_size,
+	       unsigned long pt_size, unsigned long pt_l, unsigned long pt_m )
+{
+  int i;
+
+  memset( p, 0, SECTOR );
+  p[0] = 1;
+  memcpy( p + 1, "CD001", 5 );
+  p[6] = 1;
+  pad( (char*)p + 8, "", 32 );
+  pad( (char*)p + 40, "CDBENCH", 32 );
+  put32b( p + 80, vol_size );
+  put16b( p + 120, 1 );
+  put16b( p + 124, 1 );
+  put16b( p + 128, SECTOR );
+  put32b( p + 132, pt_size );
+  put32( p + 140, pt_l );
+  put32m( p + 148, pt_m );
+  make_rec( p + 156, "\0", 1, dirs[0].extent, dirs[0].size, 1 );
+  pad( (char*)p + 190, "", 128 * 4 + 37 * 3 );
+  pad( (char*)p + 318, "SHSUCD SUITE", 128 );
+  pad( (char*)p + 574, "MKBENCH " PVERS, 128 );
+  for (i = 0; i < 4; ++i)
+  {
+    if (i < 2)
+      memcpy( p + 813 + i * 17, vol_date, 16 );
+    else
+      memset( p + 813 + i * 17, '0', 16 );
+  }
+  p[881] = 1;
+}
+
+
+void write_data( FILE* out, unsigned long size )
+{
+  unsigned char buf[SECTOR];
+  unsigned long len;
+  int i;
+
+  for (; size; size -= len)
+  {
+    len = (size < SECTOR) ? size : SECTOR;
+    for (i = 0; i < (int)len; ++i)
+      buf[i] = random8();
+    memset( buf + len, 0, SECTOR - len );
+    fwrite( buf, SECTOR, 1, out );
+  }
+}
+
+
+int main( int argc, char* argv[] )
+{
+  static unsigned char buf[64 * SECTOR];
+  unsigned long pt_size, sector;
+  char	 name[13];
+  FILE*  out;
+  int	 i, j, files_dir, tree;
+
+  if (argc != 2 || *argv[1] == '-')
+  {
+    puts(
+"MKBENCH - make the CD image used by CDBENCH.\n"
+"Version " PVERS " (" PDATE "). Freeware.\n"
+"http://shsucdx.adoxa.vze.com/\n"
+"\n"
+"Make the CD image used by CDBENCH.\n"
+"\n"
+"mkbench image"
+    );
+    return (argc == 1) ? 0 : 1;
+  }
+
+  // The path table wants the directories level by level (and by parent
+  // within a level), so the tree is added breadth first.
+  add_dir( "", 0 );
+  files_dir = add_dir( "FILES", 0 );
+  tree = add_dir( "TREE", 0 );
+  for (i = tree; i < ndirs; ++i)
+  {
+    if (dirs[i].level - dirs[tree].level < LEVELS)
+    {
+      for (j = 0; j < FANOUT; ++j)
+      {
+	sprintf( name, "D%d", j );
+	add_dir( name, i );
+      }
+    }
+  }
+
+  add_file( 0, "BIG.DAT", BIGSIZE );
+  for (i = 0; i < SMALLS; ++i)
+  {
+    sprintf( name, "F%04d.DAT", i );
+    add_file( files_dir, name, 512 + (i * 997L) % (4096 - 512 + 1) );
+  }
+  for (i = tree; i < ndirs; ++i)
+  {
+    for (j = 0; j < TREEFILES; ++j)
+    {
+      sprintf( name, "FILE%d.TXT", j );
+      add_file( i, name, 1000 + (i * 331L + j * 577) % 6000 );
+    }
+  }
+
+  // Lay it out: system area, PVD, terminator, path tables, directories,
+  // files.  Directory sizes only depend on the names, so do them first.
+  pt_size = path_table( NULL, 0 );
+  sector  = 18 + 2 * sectors( pt_size );
+  for (i = 0; i < ndirs; ++i)
+  {
+    dirs[i].size   = dir_records( i, NULL );
+    dirs[i].extent = sector;
+    sector += dirs[i].size / SECTOR;
+  }
+  for (i = 0; i < nfiles; ++i)
+  {
+    files[i].extent = sector;
+    sector += sectors( files[i].size );
+  }
+
+  out = fopen( argv[1], "wb" );
+  if (out == NULL)
+  {
+    fprintf( stderr, "ERROR: unable to create \"%s\".\n", argv[1] );
+    return 2;
+  }
+  memset( buf, 0, SECTOR );
+  for (i = 0; i < 16; ++i)
+    fwrite( buf, SECTOR, 1, out );
+  make_pvd( buf, sector, pt_size, 18, 18 + sectors( pt_size ) );
+  fwrite( buf, SECTOR, 1, out );
+  memset( buf, 0, SECTOR );
+  buf[0] = 255;
+  memcpy( buf + 1, "CD001", 5 );
+  buf[6] = 1;
+  fwrite( buf, SECTOR, 1, out );
+  for (j = 0; j < 2; ++j)
+  {
+    memset( buf, 0, sectors( pt_size ) * SECTOR );
+    path_table( buf, j );
+    fwrite( buf, SECTOR, sectors( pt_size ), out );
+  }
+  for (i = 0; i < ndirs; ++i)
+  {
+    dir_records( i, buf );
+    fwrite( buf, SECTOR, dirs[i].size / SECTOR, out );
+  }
+  for (i = 0; i < nfiles; ++i)
+    write_data( out, files[i].size );
+
+  if (fclose( out ) != 0)
+  {
+    fprintf( stderr, "ERROR: unable to write \"%s\".\n", argv[1] );
+    return 3;
+  }
+  return 0;
+}
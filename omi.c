@@ -19,30 +19,85 @@
  *   Win32 port (image on NTFS is a single file);
  *   use creation date if there is no modification date;
  *   always use KiB for free space message (MiB might be too close to notice).
+ *
+ * v1.02, 17 October, 2026:
+ *   POSIX port (image is a single file, unless -s is used; the drive is a
+ *    device name, defaulting to /dev/cdrom);
+ *   read and write in separate threads (POSIX), so the drive keeps reading
+ *    whilst the image is being written;
+ *   source can also be an image file or pipe (-i), with the number of sectors
+ *    read at a time tuned to the source, or given with -t (POSIX);
+ *   packed image (-z), which SHSUCDHD and SHSUCDRD unpack as it's read;
+ *   sparse image (-h), leaving sectors of zeros as holes (Win32 & POSIX);
+ *   hash the disc as it's imaged, writing the hashes to a manifest, which -v
+ *    checks the disc or image against (POSIX);
+ *   rescue mode (-r), reading around errors without asking, keeping a map of
+ *    the sectors read, bad and untried, and retrying the bad (POSIX);
+ *   image several drives at once, each with its own threads, named from their
+ *    labels (POSIX);
+ *   read and write directly (-d), several requests at a time (Linux);
+ *   write the files of a split image in a single pass, allocating them first
+ *    (POSIX);
+ *   the files of a split image can take turns in several directories
+ *    ("image;dir;dir"), as SHSUDVHD now allows.
  */
 
-#define PVERS "1.01"
-#define PDATE "10 June, 2005"
+#define PVERS "1.02"
+#define PDATE "17 October, 2026"
 
 
+#ifdef __linux__
+# define _GNU_SOURCE		// fallocate
+#endif
 #include <stdlib.h>
 #include <stdio.h>
-#include <io.h>
-#include <conio.h>
 #include <time.h>
 
 #ifdef _WIN32
+# include <io.h>
+# include <conio.h>
 # define WIN32_LEAN_AND_MEAN
 # include <windows.h>
+# include <winioctl.h>
 # ifdef __MINGW32__
 #  include <tcconio.h>
 # endif
 # define far
 # define farmalloc malloc
 # define _fmemcmp  memcmp
-# define _fstrncpy strncpy
+# define _fmemcpy  memcpy
+# define _fmemset  memset
 # define setftime( h, t ) SetFileTime( h, NULL, NULL, t )
+#elif defined( __unix__ )
+# include <string.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <glob.h>
+# include <locale.h>
+# include <pthread.h>
+# include <sys/stat.h>
+# include <sys/statvfs.h>
+# include "ttyconio.h"
+# include "xfer.h"
+# include "hash.h"
+# include "uring.h"
+# define far
+# define farmalloc malloc
+# define _fmemcmp  memcmp
+# define _fmemcpy  memcpy
+# define _fmemset  memset
+# define __int64   long long
+# define O_BINARY  0
+# ifndef O_DIRECT
+#  define O_DIRECT 0		// only Linux has it, the cache is used anyway
+# endif
+typedef unsigned char  BYTE;
+typedef unsigned short WORD;
+typedef unsigned int   DWORD;	// the CD structures need it to be 32 bits
+typedef unsigned int   UINT;
 #else
+# include <io.h>
+# include <conio.h>
 # include <fcntl.h>
 # include <sys/stat.h>
 # include <alloc.h>
@@ -54,6 +109,12 @@ typedef unsigned long DWORD;
 typedef unsigned int  UINT;
 #endif
 
+#ifdef _WIN32
+typedef HANDLE IMGFILE;
+#else
+typedef int    IMGFILE;
+#endif
+
 #define PriVolDescSector 16
 #define ISO_ID		 "CD001"
 #define HSF_ID		 "CDROM"
@@ -63,6 +124,17 @@ typedef unsigned int  UINT;
 
 #define IMG_SIZE	 262144L
 #define IMG_SHIFT	 18
+#define IMG_DIRS	 8		// directories SHSUDVHD allows
+
+// Packed image (see IMAGE.TXT).
+#define CDZ_SIG 	 "CDZ\x1a"
+#define CDZ_VERSION	 1
+#define CDZ_SHIFT	 15
+#define CDZ_CHUNK	 (1u << CDZ_SHIFT)
+#define CDZ_SECTORS	 (CDZ_CHUNK >> 11)
+#define CDZ_HEADER	 16
+#define CDZ_INDEX	 256		// index entries written at a time
+#define HASH_BITS	 12
 
 #define OCTETS(from,to) (to - from + 1)
 
@@ -78,7 +150,7 @@ struct ISO_CD
   char	cr8Date [OCTETS( 814,  830 )];
   char	modDate [OCTETS( 831,  847 )];
   BYTE	Fill5	[OCTETS( 848, 2048 )];
-} far* iso;
+};
 
 struct HSF_CD
 {
@@ -92,43 +164,226 @@ struct HSF_CD
   char	cr8Date [OCTETS( 791,  806 )];
   char	modDate [OCTETS( 807,  822 )];
   BYTE	Fill5	[OCTETS( 823, 2048 )];
-} far* hsf;
+};
 
 
+int   Prepare( void );
 void  CreateCacheName( void );
+void  ImageName( char* name );
+char* BaseName( char* name );
+int   PartDirs( void );
+void  PartName( int f );
+int   ImageDisc( void );
 int   Image( DWORD start );
 void  CheckFreeSpace( DWORD volSize );
+void  CheckDirSpace( DWORD volSize );
 void  GetFTime( void );
-int   CDReadLong( UINT SectorCount, DWORD StartSector );
+int   CDReadLong( char far* buf, UINT SectorCount, DWORD StartSector );
 void  ReadPVD( void );
 void  progress( DWORD cur, DWORD max );
 int   Abort( const char* msg1, const char* msg2 );
 char* thoufmt( DWORD num );
 void  get_country_info( void );
+int   PackStart( IMGFILE handle, DWORD volSize );
+int   PackSectors( IMGFILE handle, const char far* buf, UINT n );
+int   PackEnd( IMGFILE handle );
+int   PackFlush( IMGFILE handle );
+int   PackIndex( IMGFILE handle, UINT n );
+UINT  PackChunk( const BYTE far* in, BYTE far* out );
+BYTE far* PackLen( BYTE far* op, UINT len );
+int   WriteAt( IMGFILE handle, const void far* buf, UINT len, DWORD pos );
+#if defined( _WIN32 ) || defined( __unix__ )
+int   WriteSparse( IMGFILE handle, const char far* buf, UINT n, DWORD pos );
+int   PunchHole( IMGFILE handle, DWORD pos, UINT n );
+int   IsZero( const char far* sector );
+#endif
 
 
-char far* dta;
-char  CDfmt = CD_Unknown;
 int   CD = -1;		// Drive number of the CD/DVD (A: = 0)
-int   DVD = 0;		// 1 for a DVD (>= 2GiB and not NTFS)
-char  CacheName[260];
-char* img_char;
-DWORD sectors;
+int   DVD = 0;		// 1 for a DVD (>= 2GiB and not NTFS or POSIX)
+int   packed;		// -z
+int   sparse;		// -h (never set for DOS, FAT can't have holes)
+char* part_dir[IMG_DIRS]; // directories the files of a split image take
+int   part_dirs;	  //  turns in (none if they're all with the image)
+
+struct packer
+{
+  BYTE far* in; 	// the chunk being filled
+  BYTE far* out;	// the chunk packed
+  UINT	fill;		// bytes in the chunk
+  DWORD chunk;		// number of the chunk being filled
+  DWORD first;		// chunk of index[0]
+  DWORD pos;		// file position of the next chunk
+  DWORD index[CDZ_INDEX];
+  UINT	hash[1 << HASH_BITS];
+};
+
+struct progress
+{
+  int	  old_pc;
+  int	  len;
+  clock_t begin_time, total_time, rate_time;
+  UINT	  old_time;
+  DWORD   rate_val;
+};
+
+#ifndef __unix__	// POSIX can image several drives (see below)
+struct job
+{
+  char far* dta;
+  char	CDfmt;
+  char	CacheName[260];
+  char* img_char;
+  DWORD sectors;
+  DWORD holes;		// sectors of zeros left as holes
+  DWORD old_end;	// sectors already in the image when resuming
+  struct ISO_CD far* iso;
+  struct HSF_CD far* hsf;
+#ifdef _WIN32
+  FILETIME ft;
+#else
+  struct ftime ft;
+#endif
+  struct packer pack;
+  struct progress prog;
+} the_job = { NULL, CD_Unknown }, * job = &the_job;
+#endif
 
 char  decisep = '.', thousep = ',', timesep = ':';
 char  prochar[2][4] = { "", "-+*#" };
+#ifdef __unix__
+int   ascii = 1;	// the terminal is unlikely to be using CP437
+#else
 int   ascii = 0;
+#endif
 
 #ifdef _WIN32
-FILETIME ft;
 HANDLE fdin;
 #define MAX 32
 #define FIVESECS 5000	// CLOCKS_PER_SEC == 1000
+#elif defined( __unix__ )
+UINT  xfer_count;	// sectors per read given by the user (0 to tune)
+#define MAX 32
+#define RING 8		// number of XFER_MAX-sector buffers between the threads
+#define IN_FLIGHT (RING * XFER_MAX) // most sectors being written at once (-d)
+#define HASHERS 4	// CRC-32, MD5, SHA-256 and SHA-256 of each chunk
+#define HASH_CHUNK 2048 // sectors in each chunk of the manifest (4Mi)
+#define VERIFIERS 8	// most threads checking chunks (-v)
+#define MANIFEST_VERSION 1
+#define MAP_VERSION 1
+#define RESCUE_RETRIES 3	// default retry passes over the bad sectors
+#define RESCUE_SKIP 32768	// most sectors skipped past an error (64Mi)
+#define JOBS 8		// most drives imaged at once
+int   rescue;		// -r
+UINT  retries;
+int   verify;		// -v
+int   direct;		// -d
+
+struct slot
+{
+  UINT	count;		// number of sectors in the buffer
+  int	state;
+  int	hash;		// bit for each hasher still to do it
+};
+
+struct run
+{
+  DWORD start, count;
+  char	state;
+};
+
+// Everything about imaging one drive.  Several drives can be imaged at once,
+// each job with its own threads, so every thread has the job it's working
+// on: a helper thread is given it when it's started (see struct helper).
+struct job
+{
+  char*    CDName;
+  struct xfer src;
+  char*    dta;
+  char	   CDfmt;
+  char	   CacheName[260];
+  char*    img_char;
+  DWORD    sectors;
+  DWORD    holes;	// sectors of zeros left as holes
+  DWORD    old_end;	// sectors already in the image when resuming
+  struct ISO_CD* iso;
+  struct HSF_CD* hsf;
+  time_t   ft;
+  struct packer pack;
+  struct progress prog;
+
+  int	   hashing;	// the image is being hashed
+  DWORD    hash_end;	// sectors of the image hashed
+  uint32_t hash_crc;
+  struct md5	hash_md5;
+  struct sha256 hash_sha, hash_part;
+  BYTE*    chunk_sum;	// SHA-256 of each chunk
+
+  struct slot ring[RING];
+  pthread_mutex_t ring_lock;
+  pthread_cond_t  ring_change;
+  int	   ring_quit;
+  DWORD    ring_start, ring_pos, ring_end;
+  DWORD    ring_skip;	// sectors read back from the image, not written
+  int	   ring_image;	// the image, for reading back
+  int	   ring_source; // the source opened for direct reading (-d)
+
+  int	   parts;	// files of a split image (-s), all written at once
+  int*	   part_fd;	// each of them, then each opened for direct writing
+  DWORD*   part_end;	// sectors already in each when resuming
+
+  struct run* map;	// the state of each sector when rescuing
+  int	   runs, map_max;
+  int	   pass;
+  DWORD    pass_pos;
+
+  // Imaging alongside other jobs (ImageJobs)
+  int	   disk;	// the disk being written
+  int	   rc;
+  int	   done;
+  int	   stage;	// times progress was restarted
+  int	   shown;	// stage drawn by the display (-1 when done)
+  DWORD    cur, max;	// progress of the stage
+  DWORD    drawn;	// cur last drawn
+  char	   status[80];	// last line of output
+};
+
+struct job job_list[JOBS];
+char* source[JOBS];	// the drives given
+int   jobs;		// number of them
+__thread struct job* job;	// the job of the current thread
+__thread int in_job;	// imaging alongside others (not the display)
+int   stop_jobs;	// ESC was pressed whilst imaging several
+char* image_dir;	// directory for the images of several drives
+pthread_mutex_t show_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+#define FIVESECS 5000	// clock() is CPU time, so use a millisecond timer
+clock_t ms_clock( void );
+int   KeyHit( void );	// a job only sees ESC pressed for the display
+void  InitJob( char* name );
+void  AddSource( char* name );
+int   ImageJobs( void );
+void  DiskTake( void );
+void  DiskGive( void );
+void  setftime( int handle, time_t* t );
+int   Pipeline( int handle, DWORD start, DWORD i, DWORD volSize );
+int   ImageSplit( void );
+void  ShowSize( DWORD n );
+void  HashSectors( int h, const char* buf, UINT n, DWORD i );
+void  ManifestName( char* name );
+int   WriteManifest( void );
+int   Verify( int disc );
+int   LoadMap( void );
+int   Rescue( int handle, DWORD i, DWORD volSize );
 #else
-struct ftime ft;
 #define MAX 30u
 #define FIVESECS 91	// CLOCKS_PER_SEC == 18.2 (Borland)
 #endif
+#ifndef __unix__
+#define ms_clock() clock()
+#define KeyHit()   kbhit()
+#endif
 
 enum
 {
@@ -138,20 +393,22 @@ enum
 			//  unknown CD format or no CD present
   E_EXISTS,		// Image file already exists
   E_CREATE,		// Unable to create image file or not enough free space
-  E_ABORTED		// User aborted (with read/write error)
+  E_ABORTED,		// User aborted (with read/write error)
+  E_VERIFY,		// Image doesn't match its manifest (or has none)
+  E_BAD 		// Rescued, but some sectors couldn't be read
 };
 
 
 int main( int argc, char** argv )
 {
-#ifndef _WIN32
-  union REGS regs;
-#endif
-  int	j, len;
+  int	j;
   char* dot;
   DWORD s;
-  int	rc = E_OK;
+  int	rc;
 
+#ifdef __unix__
+  job = job_list;
+#endif
   if (argc > 1)
   {
     if (argv[1][0] == '?' || argv[1][1] == '?' || !strcmp( argv[1], "--help" ))
@@ -163,19 +420,83 @@ int main( int argc, char** argv )
   "\n"
   "Create an image of a CD- or DVD-ROM.\n"
   "\n"
-  "omi [Drive] [Image] [Sectors] [-s] [-a]\n"
+#ifdef __unix__
+  "omi [Drive...] [Image] [Sectors] [-s] [-a] [-z] [-h] [-i source...]\n"
+  "    [-t count] [-r[retries]] [-d]\n"
+  "omi -v [Drive] [Image] [-s] [-i source]\n"
+  "\n"
+  "Drive:   device containing disc (default is /dev/cdrom); several are\n"
+  "         imaged at once, named from their labels (Image is the directory)\n"
+#elif defined( _WIN32 )
+  "omi [Drive] [Image] [Sectors] [-s] [-a] [-z] [-h]\n"
   "\n"
   "Drive:   drive letter containing disc (default is first CD/DVD)\n"
+#else
+  "omi [Drive] [Image] [Sectors] [-s] [-a] [-z]\n"
+  "\n"
+  "Drive:   drive letter containing disc (default is first CD/DVD)\n"
+#endif
   "Image:   name of image (default is label + \".ISO\" [CD] or \".I\" [DVD])\n"
+  "         \"Image;Dir...\" puts the files of a split image in the image's\n"
+  "         directory and each Dir in turn\n"
   "Sectors: number of sectors to image (default is entire disc)\n"
   "-s:      split the image, even if it would fit as one file\n"
-  "-a:      use an ASCII progress bar"
+  "-a:      use an ASCII progress bar\n"
+  "-z:      pack the image (default extension is \".CDZ\")"
+#if defined( _WIN32 ) || defined( __unix__ )
+  "\n"
+  "-h:      leave sectors of zeros as holes (sparse image)"
+#endif
+#ifdef __unix__
+  "\n"
+  "-i:      read from an image file or pipe (\"-\" is standard input)\n"
+  "-t:      number of sectors to read at a time (default is tuned to suit)\n"
+  "-d:      read and write directly (bypassing the cache), keeping several\n"
+  "         requests in flight\n"
+  "-r:      rescue a damaged disc: skip past errors, then retry the bad\n"
+  "         sectors (default is 3 times), keeping a map of them (\".map\")\n"
+  "-v:      check the disc (or the image, if only it is given) against the\n"
+  "         manifest written when imaging (the image's name + \".sum\")"
+#endif
 	  );
       return E_OK;
     }
 
     for (j = 1; j < argc; ++j)
     {
+#ifdef __unix__
+      if (!strncmp( argv[j], "/dev/", 5 ))
+	AddSource( argv[j] );
+      else if (argv[j][0] == '-')	// '/' starts a path
+      {
+	char o = argv[j][1] | 0x20;
+	if ((o == 'i' || o == 't') && argv[j][2] == '\0' && j+1 < argc)
+	  dot = argv[++j];
+	else
+	  dot = argv[j] + 2;
+	if (o == 's')
+	  DVD = 1;
+	else if (o == 'a')
+	  ascii = !ascii;
+	else if (o == 'z')
+	  packed = 1;
+	else if (o == 'h')
+	  sparse = 1;
+	else if (o == 'i' && *dot)
+	  AddSource( dot );
+	else if (o == 't')
+	  xfer_count = strtoul( dot, NULL, 0 );
+	else if (o == 'v')
+	  verify = 1;
+	else if (o == 'd')
+	  direct = 1;
+	else if (o == 'r')
+	{
+	  rescue  = 1;
+	  retries = (*dot) ? strtoul( dot, NULL, 0 ) : RESCUE_RETRIES;
+	}
+	else
+#else
       if (argv[j][1] == '\0' || (argv[j][1] == ':' && argv[j][2] == '\0'))
       {
 	CD = (argv[j][0] | 0x20) - 'a';
@@ -187,22 +508,99 @@ int main( int argc, char** argv )
 	  DVD = 1;
 	else if (o == 'a')
 	  ascii = !ascii;
+	else if (o == 'z')
+	  packed = 1;
+#ifdef _WIN32
+	else if (o == 'h')
+	  sparse = 1;
+#endif
 	else
-	  strcpy( CacheName, argv[j] );
+#endif
+	  ImageName( argv[j] );
       }
       else
       {
 	s = strtoul( argv[j], &dot, 0 );
 	if (*dot == '\0')
-	  sectors = s;
+	  job->sectors = s;
 	else
-	  strcpy( CacheName, argv[j] );
+	  ImageName( argv[j] );
       }
     }
   }
 
-  dta = farmalloc( MAX << 11 ); // transfer up to MAX blocks at a time
-  if (dta == NULL)
+#ifdef __unix__
+  for (j = (jobs) ? jobs : 1; --j >= 0;)
+  {
+    job = &job_list[j];
+    InitJob( (jobs) ? source[j] : "/dev/cdrom" );
+  }
+
+  // Just the image to check, so there's no need for the disc.
+  if (verify && !jobs && *job->CacheName)
+  {
+    if (DVD)			// named as Prepare does
+    {
+      job->img_char = strchr( job->CacheName, '\0' );
+      job->img_char[1] = '\0';
+      if (part_dirs && !PartDirs())
+	return E_CREATE;
+    }
+    return Verify( 0 );
+  }
+  if (jobs > 1)
+  {
+    if (!verify)
+      return ImageJobs();
+    fputs( "ERROR: Only one drive can be checked at a time.\n", stderr );
+    return E_VERIFY;
+  }
+#endif
+
+  rc = Prepare();
+  if (rc != E_OK)
+    return rc;
+
+#ifdef __unix__
+  if (verify)
+    return Verify( 1 );
+#endif
+
+  // The packed size isn't known until it's written.
+  if (!packed)
+    CheckFreeSpace( job->sectors );
+  GetFTime();
+
+  return ImageDisc();
+}
+
+
+// Find the drive, read its volume descriptor and name the image.
+int Prepare( void )
+{
+#if !defined( _WIN32 ) && !defined( __unix__ )
+  union REGS regs;
+  int	j;
+#endif
+#ifndef __unix__
+  int	len;
+  char* dot;
+#endif
+
+#ifdef __unix__
+  // A ring of buffers for the threads, aligned for direct I/O.
+  if (posix_memalign( (void**)&job->dta, 4096, RING * XFER_MAX << 11 ))
+    job->dta = NULL;
+#else
+  job->dta = farmalloc( MAX << 11 ); // transfer up to MAX blocks at a time
+#endif
+  if (packed)
+  {
+    job->pack.in  = farmalloc( CDZ_CHUNK );
+    job->pack.out = farmalloc( CDZ_CHUNK );
+  }
+  if (job->dta == NULL
+      || (packed && (job->pack.in == NULL || job->pack.out == NULL)))
   {
     fputs( "ERROR: Not enough memory.\n", stderr );
     return E_MEM;
@@ -211,8 +609,8 @@ int main( int argc, char** argv )
 #ifdef _WIN32
   if (CD == -1)
   {
-    len = GetLogicalDriveStrings( 2048, dta );
-    for (dot = dta; len; dot += 4, len -= 4)
+    len = GetLogicalDriveStrings( 2048, job->dta );
+    for (dot = job->dta; len; dot += 4, len -= 4)
     {
       if (GetDriveType( dot ) == DRIVE_CDROM)
       {
@@ -228,22 +626,29 @@ int main( int argc, char** argv )
   }
   else
   {
-    dta[0] = CD + 'A';
-    dta[1] = ':';
-    dta[2] = '/';
-    dta[3] = '\0';
-    if (GetDriveType( dta ) != DRIVE_CDROM)
+    job->dta[0] = CD + 'A';
+    job->dta[1] = ':';
+    job->dta[2] = '/';
+    job->dta[3] = '\0';
+    if (GetDriveType( job->dta ) != DRIVE_CDROM)
     {
-      fprintf( stderr, "ERROR: %c: is not a CD-ROM drive.\n", *dta );
+      fprintf( stderr, "ERROR: %c: is not a CD-ROM drive.\n", *job->dta );
       return E_NOCD;
     }
   }
-  sprintf( dta, "//./%c:", CD + 'A' );
-  fdin = CreateFile( dta, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE,
+  sprintf( job->dta, "//./%c:", CD + 'A' );
+  fdin = CreateFile( job->dta, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE,
 		     NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
   if (fdin == INVALID_HANDLE_VALUE)
   {
-    fprintf( stderr, "ERROR: Cannot open %s.\n", dta );
+    fprintf( stderr, "ERROR: Cannot open %s.\n", job->dta );
+    return E_NOCD;
+  }
+
+#elif defined( __unix__ )
+  if (!XferOpen( &job->src, job->CDName, xfer_count ))
+  {
+    fprintf( stderr, "ERROR: Cannot open %s.\n", job->CDName );
     return E_NOCD;
   }
 
@@ -275,24 +680,45 @@ int main( int argc, char** argv )
   }
 #endif
 
-  iso = (struct ISO_CD far*)dta;
-  hsf = (struct HSF_CD far*)dta;
+  job->iso = (struct ISO_CD far*)job->dta;
+  job->hsf = (struct HSF_CD far*)job->dta;
   ReadPVD();
-  if (CDfmt == CD_Unknown)
+  if (job->CDfmt == CD_Unknown)
   {
+#ifdef __unix__
+    fprintf( stderr, "ERROR: %s: unknown CD/DVD format or not ready.\n",
+	     job->CDName );
+#else
     fputs( "ERROR: Unknown CD/DVD format or drive not ready.\n", stderr );
+#endif
     return E_NOCD;
   }
 
-  if (!sectors)
-    sectors = (CDfmt == CD_ISO) ? iso->volSize : hsf->volSize;
-  if (!DVD)
+  if (!job->sectors)
+    job->sectors = (job->CDfmt == CD_ISO) ? job->iso->volSize
+					   : job->hsf->volSize;
+  if (packed && DVD)
+  {
+    fputs( "ERROR: A packed image can't be split.\n", stderr );
+    return E_CREATE;
+  }
+  if (packed)
+    sparse = 0; 	// it already packs zeros into almost nothing
+#ifdef __unix__
+  if (rescue && (packed || DVD))
+  {
+    fputs( "ERROR: A rescued image can't be packed or split.\n", stderr );
+    return E_CREATE;
+  }
+#endif
+#ifndef __unix__
+  if (!DVD && !packed)
   {
 #ifdef _WIN32
     char buf[8];
-    if (*CacheName && CacheName[1] == ':')
+    if (*job->CacheName && job->CacheName[1] == ':')
     {
-      buf[0] = *CacheName;
+      buf[0] = *job->CacheName;
       buf[1] = ':';
       buf[2] = '/';
       buf[3] = '\0';
@@ -306,65 +732,109 @@ int main( int argc, char** argv )
     GetVolumeInformation( dot, NULL, 0, NULL, NULL, NULL, buf, sizeof(buf) );
     if (strcmp( buf, "NTFS" ) != 0)
 #endif
-    DVD = (sectors >= 1048576uL);
+    DVD = (job->sectors >= 1048576uL);
   }
+#endif
 
-  if (!*CacheName)
+  if (!*job->CacheName)
     CreateCacheName();
   if (DVD)
   {
-#ifdef _WIN32
-    img_char = strchr( CacheName, '\0' );
-    img_char[1] = '\0';
+#if defined( _WIN32 ) || defined( __unix__ )
+    job->img_char = strchr( job->CacheName, '\0' );
+    job->img_char[1] = '\0';
 #else
-    dot = img_char = (CacheName[1] == ':') ? CacheName+2 : CacheName;
-    for (j = 0; CacheName[j]; ++j)
+    dot = job->img_char = (job->CacheName[1] == ':') ? job->CacheName+2
+						       : job->CacheName;
+    for (j = 0; job->CacheName[j]; ++j)
     {
-      if (CacheName[j] == '/' || CacheName[j] == '\\')
-	img_char = CacheName + j + 1;
-      else if (CacheName[j] == '.')
-	dot = CacheName + j + 1;
+      if (job->CacheName[j] == '/' || job->CacheName[j] == '\\')
+	job->img_char = job->CacheName + j + 1;
+      else if (job->CacheName[j] == '.')
+	dot = job->CacheName + j + 1;
     }
-    if (dot > img_char)
+    if (dot > job->img_char)
     {
-      img_char = dot;
+      job->img_char = dot;
       len = 3;
     }
     else
       len = 8;
-    j = strlen( img_char );
+    j = strlen( job->img_char );
     if (j >= len)
-      img_char += len - 1;
+      job->img_char += len - 1;
     else
     {
-      img_char += j;
-      img_char[1] = '\0';
+      job->img_char += j;
+      job->img_char[1] = '\0';
     }
 #endif
+    if (part_dirs && !PartDirs())
+      return E_CREATE;
   }
 
-  CheckFreeSpace( sectors );
-  GetFTime();
+#ifdef __unix__
+  if (!verify)
+  {
+    job->hashing   = 1;
+    job->hash_crc  = 0;
+    job->chunk_sum = malloc( (job->sectors / HASH_CHUNK + 1) * SHA256_SIZE );
+    if (job->chunk_sum == NULL)
+    {
+      fputs( "ERROR: Not enough memory.\n", stderr );
+      return E_MEM;
+    }
+    Md5Init( &job->hash_md5 );
+    Sha256Init( &job->hash_sha );
+    Sha256Init( &job->hash_part );
+  }
+#endif
+
+  return E_OK;
+}
+
+
+// Image the disc (each file of a DVD) and write its manifest.
+int ImageDisc( void )
+{
+#ifndef __unix__
+  DWORD s;
+  int	f;
+#endif
+  int	rc = E_OK;
 
   if (DVD)
   {
-    for (*img_char = 'A', s = 0; s < sectors; ++*img_char, s += IMG_SIZE)
+#ifdef __unix__
+    rc = ImageSplit();
+#else
+    for (f = 0, s = 0; s < job->sectors; ++f, s += IMG_SIZE)
     {
+      PartName( f );
       rc = Image( s );
       if (rc != E_OK)
 	break;
     }
+#endif
   }
   else
     rc = Image( 0 );
 
+#ifdef __unix__
+  if (rc == E_OK && job->hashing && !WriteManifest())
+    rc = E_CREATE;
+#endif
+
   return rc;
 }
 
 
 int Image( DWORD start )
 {
-  DWORD i, n, volSize;
+  DWORD i, volSize;
+#ifndef __unix__
+  DWORD n;
+#endif
   int	rc;
   char	action;
 #ifdef _WIN32
@@ -373,6 +843,9 @@ int Image( DWORD start )
   #define write_cd( h, b, n, w ) WriteFile( h, b, n << 11, &w, NULL )
   #define back_up( h, w ) SetFilePointer( h, -(LONG)w, NULL, FILE_CURRENT )
   #define close_cd( h ) CloseHandle( h )
+#elif defined( __unix__ )
+  int	handle;		// reading and writing is done by Pipeline
+  #define close_cd( h ) close( h )
 #else
   int	handle;
   WORD	w;
@@ -381,42 +854,69 @@ int Image( DWORD start )
   #define close_cd( h ) close( h )
 #endif
 
-  if (access( CacheName, 0 ) == 0)
+#ifdef __unix__
+  if (rescue && LoadMap())
+    action = 0; 	// carry on from the map
+  else
+#endif
+  if (access( job->CacheName, 0 ) == 0)
   {
+#ifdef __unix__
+    if (in_job) 		// can't ask
+    {
+      cprintf( "\"%s\" already exists.", job->CacheName );
+      return E_EXISTS;
+    }
+#endif
+    // A packed image is written out of order, so it can't be resumed.
     printf( "\"%s\" already exists.\n"
-	    "Press 'O' to overwrite, 'R' to resume, anything else to exit.\n",
-	    CacheName );
+	    "Press 'O' to overwrite, %sanything else to exit.\n",
+	    job->CacheName, (packed) ? "" : "'R' to resume, " );
     action = getch() | 0x20;
-    if (action != 'o' && action != 'r')
+    if (action != 'o' && (action != 'r' || packed))
       return E_EXISTS;
   }
   else
     action = 0;
 
 #ifdef _WIN32
-  handle = CreateFile( CacheName, GENERIC_WRITE, 0, NULL,
-		       (action == 'o') ? CREATE_ALWAYS : OPEN_ALWAYS, 0, NULL );
+  handle = CreateFile( job->CacheName, GENERIC_WRITE, 0, NULL,
+		       (action == 'o' || packed) ? CREATE_ALWAYS : OPEN_ALWAYS,
+		       0, NULL );
+  // Only NTFS has sparse files; anywhere else the zeros are just written.
+  if (sparse && handle != INVALID_HANDLE_VALUE
+      && !DeviceIoControl( handle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &w,
+			   NULL ))
+    sparse = 0;
   if (handle == INVALID_HANDLE_VALUE)
 #else
   rc = O_BINARY | O_CREAT | O_WRONLY;
-  if (action == 'o')
+#ifdef __unix__
+  if (rescue)
+    rc = O_CREAT | O_RDWR;	// it's hashed afterwards
+#endif
+  if (action == 'o' || packed)
     rc |= O_TRUNC;
-  handle = open( CacheName, rc, S_IWRITE );
+#ifdef __unix__
+  handle = open( job->CacheName, rc, 0666 );
+#else
+  handle = open( job->CacheName, rc, S_IWRITE );
+#endif
   if (handle == -1)
 #endif
   {
-    fprintf( stderr, "ERROR: \"%s\" could not be created.\n", CacheName );
+    fprintf( stderr, "ERROR: \"%s\" could not be created.\n", job->CacheName );
     return E_CREATE;
   }
 
   if (DVD)
   {
     volSize = IMG_SIZE + 30;
-    if (start + volSize > sectors)
-      volSize = sectors - start;
+    if (start + volSize > job->sectors)
+      volSize = job->sectors - start;
   }
   else
-    volSize = sectors;
+    volSize = job->sectors;
 
   if (action)
   {
@@ -425,12 +925,18 @@ int Image( DWORD start )
     gotoxy( 1, wherey() - 1 );
     clreol();
   }
-#if !defined( _WIN32 )
-  printf( "Writing \"%s\"; size: %s.\n", CacheName, thoufmt( volSize << 11 ) );
+#if !defined( _WIN32 ) && !defined( __unix__ )
+  printf( "Writing \"%s\"; size: %s.\n", job->CacheName,
+	  thoufmt( volSize << 11 ) );
 #elif defined( __LCC__ )
-  printf( "Writing \"%s\"; size: %'I64d.\n", CacheName, (INT64)volSize << 11 );
+  printf( "Writing \"%s\"; size: %'I64d.\n", job->CacheName,
+	  (INT64)volSize << 11 );
+#elif defined( __unix__ )
+  // As a job this is its status, so it's console output.
+  cprintf( "Writing \"%s\"; size: ", job->CacheName );
+  ShowSize( volSize );
 #else
-  printf( "Writing \"%s\"; size: ", CacheName );
+  printf( "Writing \"%s\"; size: ", job->CacheName );
   if (volSize < 2097152) puts( thoufmt( volSize << 11 ) );
   else
   {
@@ -442,16 +948,23 @@ int Image( DWORD start )
 
   _setcursortype( _NOCURSOR );
   rc = E_OK;
+  job->holes = job->old_end = 0;
   if (action == 'r')
   {
     // Back up a bit, since there may have been a write error.
 #ifdef _WIN32
     LARGE_INTEGER fs;
     fs.LowPart = GetFileSize( handle, (PULONG)&fs.HighPart );
-    i = (DWORD)(fs.QuadPart >> 11);
+    i = job->old_end = (DWORD)(fs.QuadPart >> 11);
     i = (i <= MAX) ? 0 : i - MAX;
     fs.QuadPart = (LONGLONG)i << 11;
     SetFilePointer( handle, fs.LowPart, &fs.HighPart, FILE_BEGIN );
+#elif defined( __unix__ )
+    // Writing directly, the writes finish in any order, so any of those
+    // still in flight may have left a gap (whichever way it's resumed).
+    i = job->old_end = (DWORD)(lseek( handle, 0, SEEK_END ) >> 11);
+    i = (i <= IN_FLIGHT) ? 0 : i - IN_FLIGHT;
+    lseek( handle, (off_t)i << 11, SEEK_SET );
 #else
     i = filelength( handle ) >> 11;
     i = (i <= MAX) ? 0 : i - MAX;
@@ -461,6 +974,18 @@ int Image( DWORD start )
   else
     i = 0;
   progress( ~0, volSize );
+  if (packed && !PackStart( handle, volSize ))
+    goto aborted;
+#ifdef __unix__
+  if (rescue)
+  {
+    rc = Rescue( handle, i, volSize );
+    if (rc == E_ABORTED)
+      goto aborted;
+  }
+  else if (!Pipeline( handle, start, i, volSize ))
+    goto aborted;
+#else
   while (i < volSize)
   {
     progress( i, volSize );
@@ -469,15 +994,27 @@ int Image( DWORD start )
     if (n > MAX)
       n = MAX;
 
-    while (!CDReadLong( (UINT)n, start + i ))
+    while (!CDReadLong( job->dta, (UINT)n, start + i ))
     {
       if (Abort( "Read error", "try again" ))
 	goto aborted;
     }
 
-    for (;;)
+    if (packed)
+    {
+      if (!PackSectors( handle, job->dta, (UINT)n ))
+	goto aborted;
+    }
+#ifdef _WIN32
+    else if (sparse)
     {
-      write_cd( handle, dta, n, w );
+      if (!WriteSparse( handle, job->dta, (UINT)n, i ))
+	goto aborted;
+    }
+#endif
+    else for (;;)
+    {
+      write_cd( handle, job->dta, n, w );
       if (w == ((UINT)n << 11))
 	break;
       if (Abort( "Write error", "try again" ))
@@ -485,7 +1022,7 @@ int Image( DWORD start )
       back_up( handle, w );
     }
 
-    if (kbhit())
+    if (KeyHit())
     {
       if (Abort( "Paused", "continue" ))
 	goto aborted;
@@ -493,11 +1030,33 @@ int Image( DWORD start )
 
     i += n;
   }
-  if (rc == E_OK)
+#endif
+  if (packed && !PackEnd( handle ))
+    goto aborted;
+  if (rc == E_OK || rc == E_BAD)
   {
     putch( '\r' );
     clreol();
-    setftime( handle, &ft );
+    if (packed)
+      cprintf( "Packed size: %s.\r\n", thoufmt( job->pack.pos ) );
+#if defined( _WIN32 ) || defined( __unix__ )
+    if (sparse)
+    {
+      // Trailing holes were never written, so extend the file over them.
+#ifdef _WIN32
+      LARGE_INTEGER fs;
+      fs.QuadPart = (LONGLONG)volSize << 11;
+      SetFilePointer( handle, fs.LowPart, &fs.HighPart, FILE_BEGIN );
+      SetEndOfFile( handle );
+#else
+      if (ftruncate( handle, (off_t)volSize << 11 ))
+	cprintf( "Unable to set the size of the image.\r\n" );
+#endif
+      cprintf( "Empty sectors: %s (left as holes).\r\n",
+	       thoufmt( job->holes ) );
+    }
+#endif
+    setftime( handle, &job->ft );
   }
   else
   {
@@ -515,62 +1074,71 @@ int Image( DWORD start )
 
 void progress( DWORD cur, DWORD max )
 {
-  static int old_pc;
-  static int len;
-	 int pc;
-
-  static clock_t begin_time, total_time, rate_time;
-  static UINT	 old_time;
-  static DWORD	 rate_val;
-	 clock_t elapsed;
+  int	  pc;
+  clock_t elapsed;
 
+#ifdef __unix__
+  if (in_job)
+  {
+    // The display draws it, along with the others (ShowJobs).
+    pthread_mutex_lock( &show_lock );
+    if (cur == ~0)
+      ++job->stage;
+    job->cur = cur;
+    job->max = max;
+    pthread_mutex_unlock( &show_lock );
+    return;
+  }
+#endif
   if (cur == ~0)
   {
     char* p;
-    len = strlen( p = thoufmt( max ) );
+    job->prog.len = strlen( p = thoufmt( max ) );
     cprintf( "  0%c0%% [..................................................] %s"
 	     , decisep, p );
-    rate_time  = begin_time = clock();
-    rate_val   = 0;
-    old_pc     = 0;
+    job->prog.rate_time = job->prog.begin_time = ms_clock();
+    job->prog.rate_val  = 0;
+    job->prog.old_pc    = 0;
     return;
   }
-  if (rate_val == 0)
-    rate_val = cur;
+  if (job->prog.rate_val == 0)
+    job->prog.rate_val = cur;
 
   // This is number of sectors, so there's no problem with overflow.
   pc = (int)(1000 * cur / max);
   cprintf( "\r%3d%c%d", pc / 10, decisep, pc % 10 );
 
   pc /= 5;
-  gotoxy( 9 + (old_pc >> 2), wherey() );
-  while ((old_pc >> 2) < (pc >> 2))
+  gotoxy( 9 + (job->prog.old_pc >> 2), wherey() );
+  while ((job->prog.old_pc >> 2) < (pc >> 2))
   {
     putch( prochar[ascii][3] );
-    old_pc += 4;
+    job->prog.old_pc += 4;
   }
   if (pc & 3)
     putch( prochar[ascii][(pc & 3) - 1] );
 
   gotoxy( 61, wherey() );
-  cprintf( "%*s", len, thoufmt( max - cur ) );
+  cprintf( "%*s", job->prog.len, thoufmt( max - cur ) );
 
-  elapsed = clock() - begin_time;
+  elapsed = ms_clock() - job->prog.begin_time;
   if (elapsed >= FIVESECS)
   {
-    if (elapsed - rate_time >= FIVESECS)
+    if (elapsed - job->prog.rate_time >= FIVESECS)
     {
-      total_time = elapsed + (max - cur) * (elapsed - rate_time)
-					 / (cur - rate_val);
-      rate_time  = elapsed;
-      rate_val	 = cur;
+      job->prog.total_time = elapsed + (max - cur)
+				       * (elapsed - job->prog.rate_time)
+				       / (cur - job->prog.rate_val);
+      job->prog.rate_time  = elapsed;
+      job->prog.rate_val   = cur;
     }
-    elapsed = (elapsed >= total_time) ? 0 : (total_time - elapsed) * 5/FIVESECS;
-    if ((UINT)elapsed != old_time)
+    elapsed = (elapsed >= job->prog.total_time) ? 0
+	      : (job->prog.total_time - elapsed) * 5/FIVESECS;
+    if ((UINT)elapsed != job->prog.old_time)
     {
-      gotoxy( 63 + len, wherey() );
+      gotoxy( 63 + job->prog.len, wherey() );
       cprintf( "%2d%c%02d", (UINT)elapsed / 60, timesep, (UINT)elapsed % 60 );
-      old_time = (UINT)elapsed;
+      job->prog.old_time = (UINT)elapsed;
     }
   }
 }
@@ -580,6 +1148,14 @@ int Abort( const char* msg1, const char* msg2 )
 {
   int rc;
 
+#ifdef __unix__
+  // Only the display reads the keyboard, so a job just stops.
+  if (in_job)
+  {
+    cprintf( "%s.", (KeyHit()) ? "Stopped" : msg1 );
+    return 1;
+  }
+#endif
   cprintf( "\r\n%s: press ESC to abort, anything else to %s.", msg1, msg2 );
   while (kbhit()) getch();
   rc = getch();
@@ -595,7 +1171,7 @@ int Abort( const char* msg1, const char* msg2 )
 }
 
 
-int CDReadLong( UINT SectorCount, DWORD StartSector )
+int CDReadLong( char far* buf, UINT SectorCount, DWORD StartSector )
 {
 #ifdef _WIN32
   static LARGE_INTEGER pos;
@@ -606,16 +1182,19 @@ int CDReadLong( UINT SectorCount, DWORD StartSector )
   ofs.QuadPart = (LONGLONG)StartSector << 11;
   if (ofs.QuadPart != pos.QuadPart)
     SetFilePointer( fdin, ofs.LowPart, &ofs.HighPart, FILE_BEGIN );
-  ReadFile( fdin, dta, SectorCount << 11, &len, NULL );
+  ReadFile( fdin, buf, SectorCount << 11, &len, NULL );
   pos.QuadPart += len;
   return (len == (SectorCount << 11));
 
+#elif defined( __unix__ )
+  return XferRead( &job->src, buf, SectorCount, StartSector );
+
 #else
   struct REGPACK regs;
 
   regs.r_ax = 0x1508;
-  regs.r_es = FP_SEG( dta );
-  regs.r_bx = FP_OFF( dta );
+  regs.r_es = FP_SEG( buf );
+  regs.r_bx = FP_OFF( buf );
   regs.r_cx = CD;
   regs.r_si = (WORD)(StartSector >> 16);
   regs.r_di = (WORD)StartSector;
@@ -628,17 +1207,43 @@ int CDReadLong( UINT SectorCount, DWORD StartSector )
 
 void ReadPVD( void )
 {
-  if (CDReadLong( 1, PriVolDescSector ))
+  if (CDReadLong( job->dta, 1, PriVolDescSector ))
   {
-    if (_fmemcmp( iso->cdID, ISO_ID, sizeof(iso->cdID) ) == 0)
-      CDfmt = CD_ISO;
-    else if (_fmemcmp( hsf->cdID, HSF_ID, sizeof(hsf->cdID) ) == 0)
-      CDfmt = CD_HSF;
+    if (_fmemcmp( job->iso->cdID, ISO_ID, sizeof(job->iso->cdID) ) == 0)
+      job->CDfmt = CD_ISO;
+    else if (_fmemcmp( job->hsf->cdID, HSF_ID, sizeof(job->hsf->cdID) ) == 0)
+      job->CDfmt = CD_HSF;
   }
 }
 
 
+// Check there's room for the image.  The files of a split image that go in
+// other directories are checked where they go.
 void CheckFreeSpace( DWORD volSize )
+{
+  DWORD need, s;
+  int	d, f;
+
+  if (!DVD || !part_dirs)
+  {
+    CheckDirSpace( volSize );
+    return;
+  }
+  for (d = 0; d < part_dirs; ++d)
+  {
+    need = 0;
+    for (f = d; (s = (DWORD)f * IMG_SIZE) < volSize; f += part_dirs)
+      need += (volSize - s < IMG_SIZE) ? volSize - s : IMG_SIZE;
+    if (need)
+    {
+      PartName( d );
+      CheckDirSpace( need );
+    }
+  }
+}
+
+
+void CheckDirSpace( DWORD volSize )
 {
   DWORD cluster, free;
 #ifdef _WIN32
@@ -646,6 +1251,14 @@ void CheckFreeSpace( DWORD volSize )
   char	drv_str[MAX_PATH];
   WIN32_FIND_DATA find;
   HANDLE hfind;
+#elif defined( __unix__ )
+  char	drv_str[260];
+  char* slash;
+  struct statvfs fs;
+  struct stat st;
+  glob_t find;
+  unsigned long long avail;
+  size_t j;
 #else
   int	drv;
   char	drv_str[4];
@@ -669,9 +1282,9 @@ void CheckFreeSpace( DWORD volSize )
 #endif
 
 #ifdef _WIN32
-  if (CacheName[1] == ':')
+  if (job->CacheName[1] == ':')
   {
-    drv_str[0] = *CacheName & 0xdf;
+    drv_str[0] = *job->CacheName & 0xdf;
     drv_str[1] = ':';
     drv_str[2] = '/';
   }
@@ -683,9 +1296,26 @@ void CheckFreeSpace( DWORD volSize )
   GetDiskFreeSpace( drv_str, &spc, &bps, &free, NULL );
   cluster = spc * bps;
 
+#elif defined( __unix__ )
+  strcpy( drv_str, job->CacheName );
+  slash = strrchr( drv_str, '/' );
+  if (slash == NULL)
+    strcpy( drv_str, "." );
+  else
+    slash[1] = '\0';
+  if (statvfs( drv_str, &fs ))
+  {
+    fprintf( stderr, "ERROR: %s is an invalid directory.\n", drv_str );
+    exit( E_CREATE );
+  }
+  // Work in sectors, since a DWORD of clusters could overflow when normalised.
+  cluster = 2048;
+  avail = ((unsigned long long)fs.f_bavail * fs.f_frsize) >> 11;
+  free = (avail > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (DWORD)avail;
+
 #else
-  if (CacheName[1] == ':')
-    drv = (*CacheName | 0x20) - 'a' + 1;
+  if (job->CacheName[1] == ':')
+    drv = (*job->CacheName | 0x20) - 'a' + 1;
   else
     _dos_getdrive( (WORD*)&drv );
 
@@ -718,11 +1348,11 @@ void CheckFreeSpace( DWORD volSize )
 
   if (DVD)
   {
-    *img_char = '?';    // May find more than intended, but never mind
-    free -= ((sectors >> IMG_SHIFT) * 30*2048 + cluster-1) / cluster;
+    *job->img_char = '?';    // May find more than intended, but never mind
+    free -= ((job->sectors >> IMG_SHIFT) * 30*2048 + cluster-1) / cluster;
   }
 #ifdef _WIN32
-  hfind = FindFirstFile( CacheName, &find );
+  hfind = FindFirstFile( job->CacheName, &find );
   if (hfind != INVALID_HANDLE_VALUE)
   {
     do
@@ -733,8 +1363,20 @@ void CheckFreeSpace( DWORD volSize )
     } while (FindNextFile( hfind, &find ));
     FindClose( hfind );
   }
+#elif defined( __unix__ )
+  if (glob( job->CacheName, 0, NULL, &find ) == 0)
+  {
+    for (j = 0; j < find.gl_pathc; ++j)
+    {
+      // Count what's allocated, since a sparse image takes less than its size.
+      if (stat( find.gl_pathv[j], &st ) == 0)
+	free += (DWORD)(((unsigned long long)st.st_blocks * 512 + cluster-1)
+			/ cluster);
+    }
+    globfree( &find );
+  }
 #else
-  drv = _dos_findfirst( CacheName, FA_HIDDEN | FA_SYSTEM, &find );
+  drv = _dos_findfirst( job->CacheName, FA_HIDDEN | FA_SYSTEM, &find );
   while (drv == 0)
   {
     free += (find.size + cluster-1) / cluster;
@@ -761,10 +1403,21 @@ void CheckFreeSpace( DWORD volSize )
   }
   if (free < volSize)
   {
-    fprintf( stderr, "Not enough free space on %c: (%sKiB required, ",
+    // A sparse image only takes what isn't zeros, which can't be known until
+    // the disc is read, so it may yet fit.
+#ifdef __unix__
+    fprintf( stderr, "%s free space in %s (%sKiB required, ",
+	     (sparse) ? "Possibly not enough" : "Not enough",
+	     drv_str, thoufmt( volSize << 1 ) );
+#else
+    fprintf( stderr, "%s free space on %c: (%sKiB required, ",
+	     (sparse) ? "Possibly not enough" : "Not enough",
 	     *drv_str, thoufmt( volSize << 1 ) );
+#endif
     fprintf( stderr, "%sKiB available).\n", thoufmt( free << 1 ) );
-    exit( E_CREATE );
+    if (!sparse)
+      exit( E_CREATE );
+    fputs( "Empty sectors take no space, so trying anyway.\n", stderr );
   }
 }
 
@@ -772,11 +1425,20 @@ void CheckFreeSpace( DWORD volSize )
 void CreateCacheName( void )
 {
   char far* label;
-  char* name = CacheName;
+  char* name = job->CacheName;
   int	j;
 
-  label = (CDfmt == CD_ISO) ? iso->volLabel : hsf->volLabel;
-#ifdef _WIN32
+#ifdef __unix__
+  if (image_dir != NULL)
+  {
+    strcpy( name, image_dir );
+    name = strchr( name, '\0' );
+    if (name[-1] != '/')
+      *name++ = '/';
+  }
+#endif
+  label = (job->CDfmt == CD_ISO) ? job->iso->volLabel : job->hsf->volLabel;
+#if defined( _WIN32 ) || defined( __unix__ )
   j = 32;
 #else
   j = 8;
@@ -787,7 +1449,7 @@ void CreateCacheName( void )
       break;
     *name++ = *label++;
   }
-  if (name == CacheName)
+  if (name == job->CacheName || name[-1] == '/')
   {
     if (DVD)
     {
@@ -801,26 +1463,144 @@ void CreateCacheName( void )
       *name++ = 'D';
     }
   }
-  strcpy( name, (DVD) ? ".I" : ".ISO" );
+  strcpy( name, (DVD) ? ".I" : (packed) ? ".CDZ" : ".ISO" );
+}
+
+
+// Take the name of the image, which may be followed by directories for the
+// files of a split image to take turns in ("name;dir;dir").
+void ImageName( char* name )
+{
+  char* dir;
+  size_t len;
+
+  dir = strchr( name, ';' );
+  if (dir != NULL)
+  {
+    *dir++ = '\0';
+    part_dirs = 1;		// the image's own, set by PartDirs
+    for (dir = strtok( dir, ";" ); dir != NULL; dir = strtok( NULL, ";" ))
+    {
+      if (part_dirs == IMG_DIRS)
+      {
+	fprintf( stderr, "ERROR: Only %d directories can be used.\n",
+		 IMG_DIRS );
+	exit( E_CREATE );
+      }
+      len = strlen( dir );
+      part_dir[part_dirs] = malloc( len + 2 );
+      if (part_dir[part_dirs] == NULL)
+      {
+	fputs( "ERROR: Not enough memory.\n", stderr );
+	exit( E_MEM );
+      }
+      strcpy( part_dir[part_dirs], dir );
+#ifdef __unix__
+      if (dir[len - 1] != '/')
+	strcat( part_dir[part_dirs], "/" );
+#else
+      if (dir[len - 1] != '/' && dir[len - 1] != '\\' && dir[len - 1] != ':')
+	strcat( part_dir[part_dirs], "\\" );
+#endif
+      ++part_dirs;
+    }
+    if (part_dirs == 1)
+      part_dirs = 0;
+  }
+  strcpy( job->CacheName, name );
+}
+
+
+// Return the name without its directory.
+char* BaseName( char* name )
+{
+  char* base = name;
+
+  for (; *name; ++name)
+  {
+#ifdef __unix__
+    if (*name == '/')
+#else
+    if (*name == '/' || *name == '\\' || *name == ':')
+#endif
+      base = name + 1;
+  }
+  return base;
+}
+
+
+// Take the image's directory as the first of the split image's, making sure
+// the name fits in each of the others.
+int PartDirs( void )
+{
+  char* base = BaseName( job->CacheName );
+  int	d;
+
+  if (part_dir[0] == NULL)
+  {
+    part_dir[0] = malloc( base - job->CacheName + 1 );
+    if (part_dir[0] == NULL)
+    {
+      fputs( "ERROR: Not enough memory.\n", stderr );
+      return 0;
+    }
+    memcpy( part_dir[0], job->CacheName, base - job->CacheName );
+    part_dir[0][base - job->CacheName] = '\0';
+  }
+  for (d = 1; d < part_dirs; ++d)
+  {
+    if (strlen( part_dir[d] ) + strlen( base ) >= sizeof(job->CacheName))
+    {
+      fprintf( stderr, "ERROR: \"%s%s\" is too long.\n", part_dir[d], base );
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+// Name file f of a split image.  That's just its letter, unless there are
+// other directories, when it's in its turn of them.
+void PartName( int f )
+{
+  char* base, *dir;
+  size_t tail, len;
+
+  if (part_dirs)
+  {
+    tail = strlen( job->img_char );
+    base = BaseName( job->CacheName );
+    dir  = part_dir[f % part_dirs];
+    len  = strlen( dir );
+    memmove( job->CacheName + len, base, strlen( base ) + 1 );
+    memcpy( job->CacheName, dir, len );
+    job->img_char = strchr( job->CacheName, '\0' ) - tail;
+  }
+  *job->img_char = (char)('A' + f);
 }
 
 
 void GetFTime( void )
 {
-  char far* mod = (CDfmt == CD_ISO) ? iso->modDate : hsf->modDate;
+  char far* mod = (job->CDfmt == CD_ISO) ? job->iso->modDate
+					 : job->hsf->modDate;
   char buf[16];
   int  year, month, day, hour, min, sec;
 #ifdef _WIN32
   SYSTEMTIME t;
+#elif defined( __unix__ )
+  struct tm t;
 #endif
 
-  _fstrncpy( buf, mod, 14 );
+  _fmemcpy( buf, mod, 14 );
+  buf[14] = '\0';
   sscanf( buf, "%4d%2d%2d%2d%2d%2d", &year, &month, &day,
 				     &hour, &min,   &sec );
   if (year == 0)
   {
-    mod = (CDfmt == CD_ISO) ? iso->cr8Date : hsf->cr8Date;
-    _fstrncpy( buf, mod, 14 );
+    mod = (job->CDfmt == CD_ISO) ? job->iso->cr8Date : job->hsf->cr8Date;
+    _fmemcpy( buf, mod, 14 );
+    buf[14] = '\0';
     sscanf( buf, "%4d%2d%2d%2d%2d%2d", &year, &month, &day,
 				       &hour, &min,   &sec );
   }
@@ -832,21 +1612,34 @@ void GetFTime( void )
   t.wMinute = min;
   t.wSecond = sec;
   t.wMilliseconds = 0;
-  SystemTimeToFileTime( &t, &ft );
+  SystemTimeToFileTime( &t, &job->ft );
+#elif defined( __unix__ )
+  t.tm_year  = year - 1900;
+  t.tm_mon   = month - 1;
+  t.tm_mday  = day;
+  t.tm_hour  = hour;
+  t.tm_min   = min;
+  t.tm_sec   = sec;
+  t.tm_isdst = -1;
+  job->ft = mktime( &t );
 #else
-  ft.ft_year  = year - 1980;
-  ft.ft_month = month;
-  ft.ft_day   = day;
-  ft.ft_hour  = hour;
-  ft.ft_min   = min;
-  ft.ft_tsec  = sec >> 1;
+  job->ft.ft_year  = year - 1980;
+  job->ft.ft_month = month;
+  job->ft.ft_day   = day;
+  job->ft.ft_hour  = hour;
+  job->ft.ft_min   = min;
+  job->ft.ft_tsec  = sec >> 1;
 #endif
 }
 
 
 char* thoufmt( DWORD num )
 {
+#ifdef __unix__
+  static __thread char buf[16];
+#else
   static char buf[16];
+#endif
 
 #ifdef __LCC__
   sprintf( buf, "%'lu", num );
@@ -889,6 +1682,16 @@ void get_country_info( void )
   if (GetLocaleInfo( LOCALE_USER_DEFAULT, LOCALE_STIME, &sep, 1 ))
     timesep = sep;
 
+#elif defined( __unix__ )
+  struct lconv* lc;
+
+  setlocale( LC_NUMERIC, "" );
+  lc = localeconv();
+  if (*lc->decimal_point)
+    decisep = *lc->decimal_point;
+  if (*lc->thousands_sep)
+    thousep = *lc->thousands_sep;
+
 #else
   struct COUNTRY c;
 
@@ -900,3 +1703,2077 @@ void get_country_info( void )
   }
 #endif
 }
+
+
+/*
+ * A packed image is split into chunks of CDZ_CHUNK bytes, each packed on its
+ * own, so a driver need only unpack the chunks a read covers. The header is
+ * followed by the index: the file position of each chunk and the end of the
+ * last. A chunk is packed as an LZ4 block, or stored as is if that would not
+ * make it smaller (so its length is CDZ_CHUNK). The last chunk is padded with
+ * zeros. The chunks are written as they're filled and the index is written
+ * CDZ_INDEX entries at a time, so nothing needs to be read back.
+ */
+
+// Write the header and position the first chunk after the index.
+int PackStart( IMGFILE handle, DWORD volSize )
+{
+  BYTE	hdr[CDZ_HEADER];
+  DWORD chunks;
+
+  chunks = (volSize + CDZ_SECTORS - 1) / CDZ_SECTORS;
+  memcpy( hdr, CDZ_SIG, 4 );
+  *(WORD*)(hdr + 4)   = CDZ_VERSION;
+  *(WORD*)(hdr + 6)   = CDZ_SHIFT;
+  *(DWORD*)(hdr + 8)  = volSize;
+  *(DWORD*)(hdr + 12) = chunks;
+
+  job->pack.fill  = 0;
+  job->pack.chunk = job->pack.first = 0;
+  job->pack.pos   = CDZ_HEADER + (chunks + 1) * 4;
+
+  return WriteAt( handle, hdr, CDZ_HEADER, 0 );
+}
+
+
+// Add sectors to the image, writing each chunk as it's filled.
+int PackSectors( IMGFILE handle, const char far* buf, UINT n )
+{
+  UINT len;
+
+  for (n <<= 11; n; n -= len)
+  {
+    len = CDZ_CHUNK - job->pack.fill;
+    if (len > n)
+      len = n;
+    _fmemcpy( job->pack.in + job->pack.fill, buf, len );
+    buf += len;
+    job->pack.fill += len;
+    if (job->pack.fill == CDZ_CHUNK && !PackFlush( handle ))
+      return 0;
+  }
+
+  return 1;
+}
+
+
+// Write the last chunk and the rest of the index.
+int PackEnd( IMGFILE handle )
+{
+  if (job->pack.fill != 0)
+  {
+    _fmemset( job->pack.in + job->pack.fill, 0, CDZ_CHUNK - job->pack.fill );
+    job->pack.fill = CDZ_CHUNK;
+    if (!PackFlush( handle ))
+      return 0;
+  }
+  job->pack.index[(UINT)(job->pack.chunk - job->pack.first)] = job->pack.pos;
+
+  return PackIndex( handle, (UINT)(job->pack.chunk - job->pack.first) + 1 );
+}
+
+
+// Pack the chunk, write it and add it to the index.
+int PackFlush( IMGFILE handle )
+{
+  UINT len;
+  UINT k;
+
+  len = PackChunk( job->pack.in, job->pack.out );
+  if (len == 0)
+    len = CDZ_CHUNK;
+  if (job->pack.pos + len < job->pack.pos)
+  {
+    cprintf( "\r\nThe packed image would be 4GiB or more." );
+    return 0;
+  }
+  if (!WriteAt( handle, (len == CDZ_CHUNK) ? job->pack.in : job->pack.out, len,
+		job->pack.pos ))
+    return 0;
+
+  k = (UINT)(job->pack.chunk - job->pack.first);
+  job->pack.index[k] = job->pack.pos;
+  job->pack.pos += len;
+  job->pack.fill = 0;
+  ++job->pack.chunk;
+
+  return (k + 1 < CDZ_INDEX) ? 1 : PackIndex( handle, CDZ_INDEX );
+}
+
+
+// Write the first n entries of the index buffer.
+int PackIndex( IMGFILE handle, UINT n )
+{
+  if (!WriteAt( handle, job->pack.index, n * 4,
+		CDZ_HEADER + job->pack.first * 4 ))
+    return 0;
+  job->pack.first += n;
+
+  return 1;
+}
+
+
+// Pack a chunk (greedy LZ4), returning its length, or 0 if it's not smaller.
+UINT PackChunk( const BYTE far* in, BYTE far* out )
+{
+  const BYTE far* ip	 = in;
+  const BYTE far* anchor = in;
+  const BYTE far* limit  = in + CDZ_CHUNK - 12; // last match starts before
+  const BYTE far* mlimit = in + CDZ_CHUNK - 5;	//  and ends before these
+  const BYTE far* ref;
+  BYTE far* op = out;
+  UINT	lit, len, h;
+
+  #define HASH( p ) ((((p)[0] | (UINT)(p)[1] << 8) \
+		    ^ ((p)[2] | (UINT)(p)[3] << 8) * 7) * 40503u \
+		    >> (16 - HASH_BITS) & ((1 << HASH_BITS) - 1))
+
+  memset( job->pack.hash, 0, sizeof(job->pack.hash) );
+  while (ip < limit)
+  {
+    h = HASH( ip );
+    ref = in + job->pack.hash[h];
+    job->pack.hash[h] = (UINT)(ip - in);
+    if (ref >= ip || _fmemcmp( ref, ip, 4 ) != 0)
+    {
+      ++ip;
+      continue;
+    }
+    for (len = 4; ip + len < mlimit && ref[len] == ip[len]; ++len) ;
+
+    // token, literals (and their length), offset, match length
+    lit = (UINT)(ip - anchor);
+    if ((UINT)(op - out) + lit + lit / 255 + len / 255 + 5 >= CDZ_CHUNK)
+      return 0;
+    *op = (BYTE)((((lit < 15) ? lit : 15) << 4)
+		 | ((len - 4 < 15) ? len - 4 : 15));
+    op = PackLen( op + 1, lit );
+    _fmemcpy( op, anchor, lit );
+    op += lit;
+    *op++ = (BYTE)(ip - ref);
+    *op++ = (BYTE)((UINT)(ip - ref) >> 8);
+    op = PackLen( op, len - 4 );
+
+    anchor = ip += len;
+    if (ip < limit)
+      job->pack.hash[HASH( ip - 2 )] = (UINT)(ip - 2 - in);
+  }
+
+  // The last sequence is just literals.
+  lit = (UINT)(in + CDZ_CHUNK - anchor);
+  if ((UINT)(op - out) + lit + lit / 255 + 2 >= CDZ_CHUNK)
+    return 0;
+  *op = (BYTE)(((lit < 15) ? lit : 15) << 4);
+  op = PackLen( op + 1, lit );
+  _fmemcpy( op, anchor, lit );
+  op += lit;
+
+  return (UINT)(op - out);
+}
+
+
+// Write the bytes that extend a length of 15 or more.
+BYTE far* PackLen( BYTE far* op, UINT len )
+{
+  if (len >= 15)
+  {
+    for (len -= 15; len >= 255; len -= 255)
+      *op++ = 255;
+    *op++ = (BYTE)len;
+  }
+  return op;
+}
+
+
+int WriteAt( IMGFILE handle, const void far* buf, UINT len, DWORD pos )
+{
+#ifdef _WIN32
+  LONG	hi;
+  DWORD w;
+#elif defined( __unix__ )
+  ssize_t w;
+#else
+  WORD	w;
+#endif
+
+  for (;;)
+  {
+#ifdef _WIN32
+    hi = 0;
+    SetFilePointer( handle, pos, &hi, FILE_BEGIN );
+    WriteFile( handle, buf, len, &w, NULL );
+    if (w == len)
+#elif defined( __unix__ )
+    w = pwrite( handle, buf, len, pos );
+    if (w == (ssize_t)len)
+#else
+    lseek( handle, pos, SEEK_SET );
+    _dos_write( handle, buf, len, &w );
+    if (w == len)
+#endif
+      return 1;
+    if (Abort( "Write error", "try again" ))
+      return 0;
+  }
+}
+
+
+#if defined( _WIN32 ) || defined( __unix__ )
+// A sector of zeros?  The library's memcmp is vectorised, so compare the
+// sector with itself a byte along, rather than testing each byte.
+int IsZero( const char far* sector )
+{
+  return (*sector == 0 && _fmemcmp( sector, sector + 1, 2047 ) == 0);
+}
+
+
+// Write n sectors at sector pos of the image, leaving the runs of zeros as
+// holes.  When resuming, a run may cover what's already written, so that has
+// to be punched out (or written, if it can't).
+int WriteSparse( IMGFILE handle, const char far* buf, UINT n, DWORD pos )
+{
+  UINT	j, run;
+  int	zero;
+#ifdef _WIN32
+  LARGE_INTEGER ofs;
+  DWORD w;
+#else
+  ssize_t w;
+#endif
+
+  for (j = 0; j < n; j += run)
+  {
+    zero = IsZero( buf + (j << 11) );
+    for (run = 1; j + run < n; ++run)
+    {
+      if (IsZero( buf + ((j + run) << 11) ) != zero)
+	break;
+    }
+    if (zero && (pos + j >= job->old_end || PunchHole( handle, pos + j, run )))
+    {
+      job->holes += run;
+      continue;
+    }
+    for (;;)
+    {
+#ifdef _WIN32
+      ofs.QuadPart = (LONGLONG)(pos + j) << 11;
+      SetFilePointer( handle, ofs.LowPart, &ofs.HighPart, FILE_BEGIN );
+      WriteFile( handle, buf + (j << 11), run << 11, &w, NULL );
+      if (w == (run << 11))
+#else
+      w = pwrite( handle, buf + (j << 11), run << 11, (off_t)(pos + j) << 11 );
+      if (w == (ssize_t)(run << 11))
+#endif
+	break;
+      if (Abort( "Write error", "try again" ))
+	return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+// Deallocate n sectors at sector pos.
+int PunchHole( IMGFILE handle, DWORD pos, UINT n )
+{
+#ifdef _WIN32
+  FILE_ZERO_DATA_INFORMATION zd;
+  DWORD w;
+
+  zd.FileOffset.QuadPart      = (LONGLONG)pos << 11;
+  zd.BeyondFinalZero.QuadPart = (LONGLONG)(pos + n) << 11;
+  return DeviceIoControl( handle, FSCTL_SET_ZERO_DATA, &zd, sizeof(zd),
+			  NULL, 0, &w, NULL );
+#elif defined( FALLOC_FL_PUNCH_HOLE )
+  return (fallocate( handle, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		     (off_t)pos << 11, (off_t)n << 11 ) == 0);
+#else
+  (void)handle; (void)pos; (void)n;
+  return 0;
+#endif
+}
+#endif
+
+
+#ifdef __unix__
+/*
+ * Reading and writing are done in separate threads, so the drive can keep
+ * streaming whilst the image is being written. The reader fills the ring of
+ * buffers in order; the writer (the thread imaging, which also looks after
+ * the screen and keyboard) empties them in the same order. A read error is
+ * passed on to the writer, which asks the user and has the reader try again
+ * or quit.
+ *
+ * Each hash has its own thread, which follows the reader through the ring;
+ * the writer doesn't empty a buffer until every hasher is done with it.
+ * When resuming, what's already in the image is read back to be hashed.
+ */
+
+enum { SLOT_EMPTY, SLOT_FULL, SLOT_ERROR, SLOT_RETRY };
+
+// The job a thread works for and, for a hasher or verifier, which one it is.
+struct helper
+{
+  struct job* job;
+  int	n;
+};
+
+// The slots being written directly (-d), count of them from first.
+struct writes
+{
+  struct uring u;
+  int	fd;
+  int	first, count;
+  int	file[RING];	// the image (or file of a split image) of each slot
+  DWORD at[RING];	// its sector in that file
+  int	res[RING];	// result of its write
+  char	done[RING];	// the write has finished
+};
+
+#define SLOT( k ) (job->dta + ((k) * XFER_MAX << 11))
+
+
+// Wait for slot k to be in a state other than the two given.
+int WaitSlot( int k, int s1, int s2 )
+{
+  int state;
+
+  pthread_mutex_lock( &job->ring_lock );
+  while ((job->ring[k].state == s1 || job->ring[k].state == s2)
+	 && !job->ring_quit)
+    pthread_cond_wait( &job->ring_change, &job->ring_lock );
+  state = (job->ring_quit) ? -1 : job->ring[k].state;
+  pthread_mutex_unlock( &job->ring_lock );
+
+  return state;
+}
+
+
+void SetSlot( int k, int state )
+{
+  pthread_mutex_lock( &job->ring_lock );
+  if (k < 0)
+    job->ring_quit = 1;
+  else
+  {
+    job->ring[k].state = state;
+    job->ring[k].hash  = (state == SLOT_FULL && job->hashing)
+			 ? (1 << HASHERS) - 1 : 0;
+  }
+  pthread_cond_broadcast( &job->ring_change );
+  pthread_mutex_unlock( &job->ring_lock );
+}
+
+
+// Number of sectors to read into a slot at sector i of the image.
+UINT SlotCount( DWORD i, UINT count )
+{
+  UINT n = (job->ring_end - i > count) ? count : (UINT)(job->ring_end - i);
+  if (i < job->ring_skip && n > job->ring_skip - i)
+    n = (UINT)(job->ring_skip - i);
+  // A slot is only ever written to one file of a split image.
+  if (job->parts && n > IMG_SIZE - i % IMG_SIZE)
+    n = (UINT)(IMG_SIZE - i % IMG_SIZE);
+  return n;
+}
+
+
+// The file to read sector i of the image back from, and where it is in it.
+int ReadBack( DWORD i, DWORD* pos )
+{
+  if (job->parts == 0)
+  {
+    *pos = i;
+    return job->ring_image;
+  }
+  *pos = i % IMG_SIZE;
+  return job->part_fd[i / IMG_SIZE];
+}
+
+
+// Read n sectors at sector i of the image into slot k, the way Reader does.
+int ReadSlot( int k, DWORD i, UINT n )
+{
+  DWORD pos;
+  int	fd;
+
+  job->ring[k].count = n;
+  if (i < job->ring_skip)
+  {
+    fd = ReadBack( i, &pos );
+    return (pread( fd, SLOT( k ), n << 11, (off_t)pos << 11 )
+	    == (ssize_t)(n << 11));
+  }
+  return CDReadLong( SLOT( k ), n, job->ring_start + i );
+}
+
+
+// Write n sectors at pos of the image the usual way, asking about errors.
+int PutSectors( int handle, const char* buf, UINT n, DWORD pos )
+{
+  if (sparse)
+    return WriteSparse( handle, buf, n, pos );
+
+  while (pwrite( handle, buf, n << 11, (off_t)pos << 11 )
+	 != (ssize_t)(n << 11))
+  {
+    if (Abort( "Write error", "try again" ))
+      return 0;
+  }
+
+  return 1;
+}
+
+
+void* Reader( void* arg )
+{
+  DWORD i;
+  UINT	n;
+  int	k;
+
+  job = arg;
+  for (i = job->ring_pos, k = 0; i < job->ring_end; i += n, k = (k + 1) % RING)
+  {
+    // The count may change as it is tuned.
+    n = SlotCount( i, job->src.count );
+    if (WaitSlot( k, SLOT_FULL, SLOT_ERROR ) == -1)
+      break;
+    // Only an error waits for the writer; a full slot is left for it.
+    while (!ReadSlot( k, i, n ))
+    {
+      SetSlot( k, SLOT_ERROR );
+      if (WaitSlot( k, SLOT_ERROR, SLOT_ERROR ) != SLOT_RETRY)
+	return NULL;
+    }
+    SetSlot( k, SLOT_FULL );
+  }
+
+  return NULL;
+}
+
+
+/*
+ * Reading directly (-d) keeps a read in flight for every empty slot, rather
+ * than one at a time, so the device always has the next request.  They
+ * finish in any order, but an error is only passed on once the slots before
+ * it are full, since the writer takes them in order.  A read the kernel
+ * won't do directly (an unaligned or short one) is done again the usual way.
+ */
+
+enum { READ_IDLE, READ_BUSY, READ_BAD };
+
+void ReadDone( char* state, int k, int ok )
+{
+  state[k] = (ok) ? READ_IDLE : READ_BAD;
+  if (ok)
+    SetSlot( k, SLOT_FULL );
+}
+
+
+void* DirectReader( void* arg )
+{
+  struct uring u;
+  DWORD i, pos, at[RING];
+  UINT	n, count;
+  int	k, j, head, busy, res, fd;
+  char	state[RING];
+  unsigned long tag;
+
+  job = arg;
+  if (!UringInit( &u, RING ))
+    return Reader( arg );
+  // Tuning needs one read at a time; with several, the largest is best.
+  count = (job->src.fixed) ? job->src.count : job->src.max;
+  memset( state, READ_IDLE, sizeof(state) );
+  i = job->ring_pos;
+  k = head = busy = 0;
+  for (;;)
+  {
+    while (busy < RING && i < job->ring_end
+	   && WaitSlot( k, -1, -1 ) == SLOT_EMPTY)
+    {
+      n = SlotCount( i, count );
+      job->ring[k].count = n;
+      at[k] = i;
+      state[k] = READ_BUSY;
+      if (i < job->ring_skip)
+	fd = ReadBack( i, &pos );
+      else
+	fd = job->ring_source, pos = job->ring_start + i;
+      if (u.fd == -1
+	  || !UringRead( &u, fd, SLOT( k ), n << 11, (off_t)pos << 11, k ))
+	ReadDone( state, k, ReadSlot( k, i, n ) );
+      k = (k + 1) % RING;
+      ++busy;
+      i += n;
+    }
+    if (busy == 0)
+    {
+      if (i >= job->ring_end || WaitSlot( k, SLOT_FULL, SLOT_ERROR ) == -1)
+	break;
+      continue;
+    }
+
+    if (u.queued + u.flight)
+    {
+      if (!UringSubmit( &u, 1 ))
+      {
+	// Do without the ring from now on.
+	UringExit( &u );
+	for (j = 0; j < RING; ++j)
+	  if (state[j] == READ_BUSY)
+	    ReadDone( state, j, ReadSlot( j, at[j], job->ring[j].count ) );
+      }
+      while (UringReap( &u, &tag, &res ))
+	ReadDone( state, tag,
+		  res == (int)(job->ring[tag].count << 11)
+		  || ReadSlot( tag, at[tag], job->ring[tag].count ) );
+    }
+
+    for (; busy && state[head] != READ_BUSY; head = (head + 1) % RING, --busy)
+    {
+      if (state[head] == READ_IDLE)
+	continue;
+      state[head] = READ_IDLE;
+      do
+      {
+	SetSlot( head, SLOT_ERROR );
+	if (WaitSlot( head, SLOT_ERROR, SLOT_ERROR ) != SLOT_RETRY)
+	  goto quit;
+      } while (!ReadSlot( head, at[head], job->ring[head].count ));
+      SetSlot( head, SLOT_FULL );
+    }
+  }
+
+quit:
+  UringExit( &u );
+  return NULL;
+}
+
+
+// Wait for the hashers to finish with slot k.
+void WaitHashed( int k )
+{
+  pthread_mutex_lock( &job->ring_lock );
+  while (job->ring[k].hash && !job->ring_quit)
+    pthread_cond_wait( &job->ring_change, &job->ring_lock );
+  pthread_mutex_unlock( &job->ring_lock );
+}
+
+
+void* Hasher( void* arg )
+{
+  DWORD i;
+  UINT	n;
+  int	k, h = ((struct helper*)arg)->n;
+
+  job = ((struct helper*)arg)->job;
+  for (i = job->ring_pos, k = 0; i < job->ring_end; i += n, k = (k + 1) % RING)
+  {
+    pthread_mutex_lock( &job->ring_lock );
+    while (!(job->ring[k].state == SLOT_FULL && (job->ring[k].hash & (1 << h)))
+	   && !job->ring_quit)
+      pthread_cond_wait( &job->ring_change, &job->ring_lock );
+    n = (job->ring_quit) ? 0 : job->ring[k].count;
+    pthread_mutex_unlock( &job->ring_lock );
+    if (n == 0)
+      break;
+
+    HashSectors( h, SLOT( k ), n, i );
+
+    pthread_mutex_lock( &job->ring_lock );
+    job->ring[k].hash &= ~(1 << h);
+    pthread_cond_broadcast( &job->ring_change );
+    pthread_mutex_unlock( &job->ring_lock );
+  }
+
+  return NULL;
+}
+
+
+// Add n sectors at sector i of the image to hash h.
+void HashSectors( int h, const char* buf, UINT n, DWORD i )
+{
+  DWORD s;
+  UINT	part;
+
+  if (i >= job->hash_end)
+    return;
+  if (n > job->hash_end - i)
+    n = (UINT)(job->hash_end - i);
+
+  switch (h)
+  {
+    case 0: job->hash_crc = Crc32( job->hash_crc, buf, n << 11 );  break;
+    case 1: Md5Update( &job->hash_md5, buf, n << 11 );		   break;
+    case 2: Sha256Update( &job->hash_sha, buf, n << 11 );	   break;
+    default:
+      // Each chunk has its own hash, so -v can check them in parallel.
+      for (s = job->ring_start + i; n; s += part, n -= part, buf += part << 11)
+      {
+	part = HASH_CHUNK - s % HASH_CHUNK;
+	if (part > n)
+	  part = n;
+	Sha256Update( &job->hash_part, buf, part << 11 );
+	if ((s + part) % HASH_CHUNK == 0 || s + part == job->sectors)
+	{
+	  Sha256Final( &job->hash_part,
+		       job->chunk_sum + s / HASH_CHUNK * SHA256_SIZE );
+	  Sha256Init( &job->hash_part );
+	}
+      }
+  }
+}
+
+
+/*
+ * Writing directly, the writes of a batch are queued as the slots are taken
+ * and the slots emptied as the writes finish, in order; the batch is only
+ * given up (to another job writing the same disk) once they all have.  A
+ * write the kernel won't do directly (the last, odd-sized, one, or anything
+ * on a file system that doesn't allow it) is done again the usual way.
+ * Returns 0 if the user gave up after a write error.
+ */
+int FlushWrites( struct writes* wr, int wait )
+{
+  unsigned long tag;
+  int	res, k;
+  UINT	n;
+
+  if (wr->count == 0)
+    return 1;
+  if (!UringSubmit( &wr->u, (wait) ? RING : 0 ))
+  {
+    // Do without the ring from now on.
+    UringExit( &wr->u );
+    for (k = 0; k < RING; ++k)
+      wr->done[k] = 1, wr->res[k] = -1;
+  }
+  while (UringReap( &wr->u, &tag, &res ))
+  {
+    wr->res[tag]  = res;
+    wr->done[tag] = 1;
+  }
+
+  for (; wr->count && wr->done[wr->first]; --wr->count)
+  {
+    k = wr->first;
+    n = job->ring[k].count;
+    if (wr->res[k] != (int)(n << 11))
+    {
+      while (pwrite( wr->file[k], SLOT( k ), n << 11,
+		     (off_t)wr->at[k] << 11 ) != (ssize_t)(n << 11))
+      {
+	if (Abort( "Write error", "try again" ))
+	{
+	  // Don't leave what came after looking like it was written.
+	  UringExit( &wr->u );
+	  if (ftruncate( wr->file[k], (off_t)wr->at[k] << 11 ))
+	    cprintf( "\r\nUnable to set the size of the image." );
+	  wr->count = 0;
+	  return 0;
+	}
+      }
+    }
+    wr->done[k] = 0;
+    WaitHashed( k );
+    SetSlot( k, SLOT_EMPTY );
+    wr->first = (k + 1) % RING;
+  }
+
+  return 1;
+}
+
+
+int Pipeline( int handle, DWORD start, DWORD i, DWORD volSize )
+{
+  pthread_t reader, hasher[HASHERS];
+  struct helper helper[HASHERS];
+  struct writes wr;
+  DWORD pos;
+  UINT	n, m;
+  int	k, f, h = 0, batch = 0, queued, file, dfd;
+
+  for (k = 0; k < RING; ++k)
+    job->ring[k].state = SLOT_EMPTY;
+  job->ring_quit  = 0;
+  job->ring_skip  = 0;
+  if (job->hashing)
+  {
+    job->hash_end = volSize;
+    if (i != 0)
+    {
+      // A split image is read back from its files, already open.
+      if (!job->parts)
+	job->ring_image = open( job->CacheName, O_RDONLY );
+      if (!job->parts && job->ring_image == -1)
+      {
+	cprintf( "\r\nUnable to read the image (to hash it)." );
+	return 0;
+      }
+      job->ring_skip = i;
+      i = 0;
+    }
+  }
+  job->ring_start = start;
+  job->ring_pos   = i;
+  job->ring_end   = volSize;
+  job->ring_source = job->src.fd;
+  memset( &wr, 0, sizeof(wr) );
+  wr.u.fd = wr.fd = -1;
+  if (direct)
+  {
+    if (job->src.type != SRC_PIPE)
+    {
+      job->ring_source = open( job->CDName, O_RDONLY | O_DIRECT );
+      if (job->ring_source == -1)
+	job->ring_source = job->src.fd;
+    }
+    // Packed and sparse images are written as they're made; a split image
+    // has its files opened for direct writing by ImageSplit.
+    if (!packed && !sparse && UringInit( &wr.u, RING ) && !job->parts)
+    {
+      wr.fd = open( job->CacheName, O_WRONLY | O_DIRECT );
+      if (wr.fd == -1)
+	wr.fd = handle;
+    }
+  }
+  if (pthread_create( &reader, NULL, (direct && job->src.type != SRC_PIPE)
+				     ? DirectReader : Reader, job ))
+  {
+    cprintf( "\r\nUnable to create the reading thread." );
+    goto closed;
+  }
+  for (; job->hashing && h < HASHERS; ++h)
+  {
+    helper[h].job = job;
+    helper[h].n   = h;
+    if (pthread_create( &hasher[h], NULL, Hasher, &helper[h] ))
+    {
+      cprintf( "\r\nUnable to create the hashing threads." );
+      goto aborted;
+    }
+  }
+
+  for (k = 0; i < volSize;)
+  {
+    progress( i, volSize );
+
+    if (WaitSlot( k, SLOT_EMPTY, SLOT_RETRY ) == SLOT_ERROR)
+    {
+      if (Abort( "Read error", "try again" ))
+	break;
+      SetSlot( k, SLOT_RETRY );
+      continue;
+    }
+    n = job->ring[k].count;
+
+    if (i >= job->ring_skip && batch++ == 0)
+      DiskTake();
+    file = handle;
+    dfd  = wr.fd;
+    pos  = i;
+    if (job->parts && i >= job->ring_skip)
+    {
+      // The start of each file is also the end of the one before it, so
+      // write it there from here, rather than read it again.
+      f   = (int)(i / IMG_SIZE);
+      pos = i % IMG_SIZE;
+      if (f && pos < 30)
+      {
+	m = (n < 30 - pos) ? n : (UINT)(30 - pos);
+	job->old_end = job->part_end[f - 1];
+	if (!PutSectors( job->part_fd[f - 1], SLOT( k ), m, IMG_SIZE + pos ))
+	  break;
+      }
+      job->old_end = job->part_end[f];	// for WriteSparse
+      file    = job->part_fd[f];
+      dfd     = job->part_fd[job->parts + f];
+    }
+    queued = 0;
+    if (i < job->ring_skip)
+      ;			// already written, it's only being hashed
+    else if (packed)
+    {
+      if (!PackSectors( handle, SLOT( k ), n ))
+	break;
+    }
+    else if (wr.u.fd != -1)
+    {
+      if (wr.count++ == 0)
+	wr.first = k;
+      wr.file[k] = file;
+      wr.at[k]	 = pos;
+      if (!UringWrite( &wr.u, dfd, SLOT( k ), n << 11, (off_t)pos << 11, k ))
+	wr.done[k] = 1, wr.res[k] = -1;
+      queued = 1;
+    }
+    else if (!PutSectors( file, SLOT( k ), n, pos ))
+      break;
+    // Keep writing whilst there's more already read (up to the whole ring),
+    // rather than have another job's writes in between.
+    if (batch && (batch == RING || WaitSlot( (k + 1) % RING, -1, -1 )
+				   != SLOT_FULL))
+    {
+      if (!FlushWrites( &wr, 1 ))
+	break;
+      DiskGive();
+      batch = 0;
+    }
+    else if (!FlushWrites( &wr, 0 ))
+      break;
+
+    if (KeyHit())
+    {
+      if (Abort( "Paused", "continue" ))
+	break;
+    }
+
+    if (!queued)	// otherwise it's emptied once it's written
+    {
+      WaitHashed( k );
+      SetSlot( k, SLOT_EMPTY );
+    }
+    k = (k + 1) % RING;
+    i += n;
+  }
+
+aborted:
+  if (wr.count)
+  {
+    // Drop what was still being written, so resuming starts before it.
+    UringExit( &wr.u );
+    if (ftruncate( wr.file[wr.first], (off_t)wr.at[wr.first] << 11 ))
+      cprintf( "\r\nUnable to set the size of the image." );
+  }
+  if (batch)
+    DiskGive();
+  SetSlot( -1, 0 );
+  pthread_join( reader, NULL );
+  while (--h >= 0)
+    pthread_join( hasher[h], NULL );
+closed:
+  if (job->ring_image != -1)
+  {
+    close( job->ring_image );
+    job->ring_image = -1;
+  }
+  if (job->ring_source != job->src.fd)
+    close( job->ring_source );
+  UringExit( &wr.u );
+  if (wr.fd != -1 && wr.fd != handle)
+    close( wr.fd );
+
+  return (i >= volSize);
+}
+
+
+// Finish the "Writing" line with the size of n sectors.
+void ShowSize( DWORD n )
+{
+  __int64 sz = (__int64)n << 11;
+
+  if (n < 2097152)
+    cprintf( "%s\r\n", thoufmt( n << 11 ) );
+  else
+  {
+    cprintf( "%s", thoufmt( (DWORD)(sz / 1000000) ) );
+    // Skip the leading 1 to keep the zeros (and separator).
+    cprintf( "%s\r\n", thoufmt( (DWORD)(sz % 1000000) + 1000000 ) + 1 );
+  }
+}
+
+
+/*
+ * A split image (-s) is written in a single pass, rather than a file at a
+ * time: every file is opened (and, unless it's sparse, has its space
+ * allocated, so the files don't fragment each other) before the disc is
+ * read, each slot is written to the file it belongs to and the first 30
+ * sectors of each file also go to the end of the one before it.  Resuming
+ * carries on from the first file that isn't complete.
+ */
+int ImageSplit( void )
+{
+  DWORD i, size;
+  int	f, rc = E_OK;
+  char	action = 0;
+
+  job->parts    = (int)((job->sectors + IMG_SIZE - 1) / IMG_SIZE);
+  job->part_fd  = malloc( job->parts * 2 * sizeof(int) );
+  job->part_end = calloc( job->parts, sizeof(DWORD) );
+  if (job->part_fd == NULL || job->part_end == NULL)
+  {
+    fputs( "ERROR: Not enough memory.\n", stderr );
+    rc = E_MEM;
+    goto done;
+  }
+  for (f = 0; f < job->parts * 2; ++f)
+    job->part_fd[f] = -1;
+
+  for (f = 0; f < job->parts; ++f)
+  {
+    PartName( f );
+    if (access( job->CacheName, 0 ) == 0)
+      break;
+  }
+  if (f < job->parts)
+  {
+    if (in_job) 		// can't ask
+    {
+      cprintf( "\"%s\" already exists.", job->CacheName );
+      rc = E_EXISTS;
+      goto done;
+    }
+    printf( "\"%s\" already exists.\n"
+	    "Press 'O' to overwrite, 'R' to resume, anything else to exit.\n",
+	    job->CacheName );
+    action = getch() | 0x20;
+    if (action != 'o' && action != 'r')
+    {
+      rc = E_EXISTS;
+      goto done;
+    }
+  }
+
+  i = (action == 'r') ? job->sectors : 0;
+  for (f = 0; f < job->parts; ++f)
+  {
+    PartName( f );
+    size = (f < job->parts - 1) ? IMG_SIZE + 30 : job->sectors - f * IMG_SIZE;
+    // Read and write, since it's read back to be hashed when resuming.
+    job->part_fd[f] = open( job->CacheName, (action == 'r') ? O_CREAT | O_RDWR
+					: O_CREAT | O_RDWR | O_TRUNC, 0666 );
+    if (job->part_fd[f] == -1)
+    {
+      fprintf( stderr, "ERROR: \"%s\" could not be created.\n",
+	       job->CacheName );
+      rc = E_CREATE;
+      goto done;
+    }
+    if (action == 'r')
+    {
+      job->part_end[f] = (DWORD)(lseek( job->part_fd[f], 0, SEEK_END ) >> 11);
+      if (job->part_end[f] < size && i == job->sectors)
+	i = f * IMG_SIZE + job->part_end[f];
+    }
+#ifdef FALLOC_FL_KEEP_SIZE
+    if (!sparse)
+      fallocate( job->part_fd[f], FALLOC_FL_KEEP_SIZE, 0, (off_t)size << 11 );
+#endif
+    if (direct && !sparse)
+      job->part_fd[job->parts + f] = open( job->CacheName,
+					   O_WRONLY | O_DIRECT );
+    if (job->part_fd[job->parts + f] == -1)
+      job->part_fd[job->parts + f] = job->part_fd[f];
+  }
+
+  if (action)
+  {
+    gotoxy( 1, wherey() - 1 );
+    clreol();
+    gotoxy( 1, wherey() - 1 );
+    clreol();
+  }
+  PartName( 0 );
+  cprintf( "Writing \"%s\"", job->CacheName );
+  PartName( job->parts - 1 );
+  cprintf( " to \"%s\"; size: ", job->CacheName );
+  ShowSize( job->sectors + (job->parts - 1) * 30 );
+
+  _setcursortype( _NOCURSOR );
+  job->holes = 0;
+  // Back up a bit, since there may have been a write error, or the files
+  // may have gaps where writes were still in flight (see Image).
+  i = (i <= IN_FLIGHT) ? 0 : i - IN_FLIGHT;
+  progress( ~0, job->sectors );
+  if (Pipeline( -1, 0, i, job->sectors ))
+  {
+    putch( '\r' );
+    clreol();
+    for (f = 0; f < job->parts; ++f)
+    {
+      // Trailing holes were never written, so extend the file over them.
+      size = (f < job->parts - 1) ? IMG_SIZE + 30
+				    : job->sectors - f * IMG_SIZE;
+      if (sparse && ftruncate( job->part_fd[f], (off_t)size << 11 ))
+	cprintf( "Unable to set the size of the image.\r\n" );
+      setftime( job->part_fd[f], &job->ft );
+    }
+    if (sparse)
+      cprintf( "Empty sectors: %s (left as holes).\r\n",
+	       thoufmt( job->holes ) );
+  }
+  else
+  {
+    rc = E_ABORTED;
+    cputs( "\r\n" );
+  }
+  _setcursortype( _NORMALCURSOR );
+
+done:
+  for (f = 0; job->part_fd != NULL && f < job->parts; ++f)
+  {
+    if (job->part_fd[job->parts + f] != job->part_fd[f])
+      close( job->part_fd[job->parts + f] );
+    if (job->part_fd[f] != -1)
+      close( job->part_fd[f] );
+  }
+  free( job->part_fd );
+  free( job->part_end );
+  job->part_fd  = NULL;
+  job->part_end = NULL;
+  job->parts    = 0;
+
+  return rc;
+}
+
+
+/*
+ * Rescue reads a damaged disc without asking about errors, recording the
+ * state of every sector in a map: '+' read, '-' bad, '?' untried.  The first
+ * pass reads what's untried, skipping past each error (twice as far each
+ * time, up to 64Mi), so the damaged areas don't hold up the rest; the second
+ * pass reads what was skipped; the remaining passes retry the bad sectors
+ * one at a time.  The map is saved as it goes (every five seconds) and when
+ * imaging stops, so a later run with -r carries on from where it was.  It has
+ * the name of the image plus ".map":
+ *
+ *	OMI map 1
+ *	Sectors: <number of sectors>
+ *	Pass: <pass> <sector it's up to>
+ *	<first sector> <number of sectors> <state>	(each run)
+ */
+
+void MapName( char* name )
+{
+  strcpy( name, job->CacheName );
+  strcat( name, ".map" );
+}
+
+
+// Make sure a run starts at pos.
+int MapSplit( DWORD pos )
+{
+  int i;
+
+  for (i = 0; i < job->runs
+	      && job->map[i].start + job->map[i].count <= pos; ++i) ;
+  if (i == job->runs || job->map[i].start == pos)
+    return 1;
+  if (job->runs == job->map_max)
+  {
+    struct run* more = realloc( job->map,
+				(job->map_max * 2) * sizeof(struct run) );
+    if (more == NULL)
+      return 0;
+    job->map = more;
+    job->map_max *= 2;
+  }
+  memmove( job->map + i + 1, job->map + i,
+	   (job->runs - i) * sizeof(struct run) );
+  ++job->runs;
+  job->map[i].count   = pos - job->map[i].start;
+  job->map[i+1].start = pos;
+  job->map[i+1].count -= job->map[i].count;
+
+  return 1;
+}
+
+
+void MapSet( DWORD start, DWORD count, char state )
+{
+  int i, j;
+
+  if (!MapSplit( start ) || !MapSplit( start + count ))
+  {
+    // Out of memory: the state is lost, so it will be tried again.
+    return;
+  }
+  for (i = 0; job->map[i].start < start; ++i) ;
+  for (j = i; j < job->runs && job->map[j].start < start + count; ++j) ;
+  job->map[i].count = count;
+  job->map[i].state = state;
+  memmove( job->map + i + 1, job->map + j,
+	   (job->runs - j) * sizeof(struct run) );
+  job->runs -= j - i - 1;
+
+  if (i + 1 < job->runs && job->map[i+1].state == state)
+  {
+    job->map[i].count += job->map[i+1].count;
+    memmove( job->map + i + 1, job->map + i + 2,
+	     (job->runs - i - 2) * sizeof(struct run) );
+    --job->runs;
+  }
+  if (i > 0 && job->map[i-1].state == state)
+  {
+    job->map[i-1].count += job->map[i].count;
+    memmove( job->map + i, job->map + i + 1,
+	     (job->runs - i - 1) * sizeof(struct run) );
+    --job->runs;
+  }
+}
+
+
+// Find the first sector in the state at or after from, and how many follow.
+int MapFind( DWORD from, char state, DWORD* start, DWORD* count )
+{
+  int i;
+
+  for (i = 0; i < job->runs; ++i)
+  {
+    if (job->map[i].state == state
+	&& job->map[i].start + job->map[i].count > from)
+    {
+      *start = (job->map[i].start > from) ? job->map[i].start : from;
+      *count = job->map[i].start + job->map[i].count - *start;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+DWORD MapCount( char state )
+{
+  DWORD n = 0;
+  int	i;
+
+  for (i = 0; i < job->runs; ++i)
+  {
+    if (job->map[i].state == state)
+      n += job->map[i].count;
+  }
+
+  return n;
+}
+
+
+int NewMap( DWORD volSize )
+{
+  job->map_max = 64;
+  job->map = malloc( job->map_max * sizeof(struct run) );
+  if (job->map == NULL)
+    return 0;
+  job->runs = 1;
+  job->map[0].start = 0;
+  job->map[0].count = volSize;
+  job->map[0].state = '?';
+  job->pass     = 1;
+  job->pass_pos = 0;
+
+  return 1;
+}
+
+
+// Read the map of the image, if there is one (and the image still exists).
+int LoadMap( void )
+{
+  FILE* f;
+  char	name[sizeof(job->CacheName) + 4], line[80], state;
+  DWORD start, count, end = 0, volSize = 0;
+  int	version;
+
+  MapName( name );
+  if (access( job->CacheName, 0 ) != 0 || (f = fopen( name, "r" )) == NULL)
+    return 0;
+  if (fgets( line, sizeof(line), f ) == NULL
+      || sscanf( line, "OMI map %d", &version ) != 1
+      || version != MAP_VERSION)
+    goto bad_map;
+  while (fgets( line, sizeof(line), f ) != NULL)
+  {
+    if (sscanf( line, "Sectors: %u", &volSize ) == 1)
+    {
+      if (volSize != job->sectors || !NewMap( volSize ))
+	goto bad_map;
+      job->runs = 0;
+    }
+    else if (sscanf( line, "Pass: %d %u", &job->pass, &job->pass_pos ) == 2)
+      ;
+    else if (sscanf( line, "%u %u %c", &start, &count, &state ) == 3)
+    {
+      if (job->map == NULL || start != end || count == 0
+	  || count > volSize - end || strchr( "+-?", state ) == NULL)
+	goto bad_map;
+      if (job->runs == job->map_max)
+      {
+	struct run* more = realloc( job->map,
+				(job->map_max * 2) * sizeof(struct run) );
+	if (more == NULL)
+	  goto bad_map;
+	job->map = more;
+	job->map_max *= 2;
+      }
+      job->map[job->runs].start = start;
+      job->map[job->runs].count = count;
+      job->map[job->runs].state = state;
+      ++job->runs;
+      end += count;
+    }
+  }
+  fclose( f );
+  if (job->map == NULL || end != volSize)
+  {
+    f = NULL;
+  bad_map:
+    if (f != NULL)
+      fclose( f );
+    free( job->map );
+    job->map = NULL;
+    fprintf( stderr, "WARNING: \"%s\" is not a map of the image "
+		     "(starting again).\n", name );
+    return 0;
+  }
+
+  cprintf( "Continuing from \"%s\" (pass %d).\r\n", name, job->pass );
+  return 1;
+}
+
+
+int SaveMap( void )
+{
+  FILE* f;
+  char	name[sizeof(job->CacheName) + 4], temp[sizeof(job->CacheName) + 8];
+  int	i;
+
+  // Write a new map and replace the old, so there's always one complete.
+  MapName( name );
+  strcpy( temp, name );
+  strcat( temp, ".new" );
+  f = fopen( temp, "w" );
+  if (f == NULL)
+    return 0;
+  fprintf( f, "OMI map %d\n", MAP_VERSION );
+  fprintf( f, "Sectors: %u\n",
+	   job->map[job->runs-1].start + job->map[job->runs-1].count );
+  fprintf( f, "Pass: %d %u\n", job->pass, job->pass_pos );
+  for (i = 0; i < job->runs; ++i)
+    fprintf( f, "%u %u %c\n",
+	     job->map[i].start, job->map[i].count, job->map[i].state );
+  if (fclose( f ) != 0 || rename( temp, name ) != 0)
+  {
+    remove( temp );
+    return 0;
+  }
+
+  return 1;
+}
+
+
+// Write n sectors at sector pos, which needn't follow the last.
+int WriteSectors( int handle, const char* buf, UINT n, DWORD pos )
+{
+  int ok;
+
+  DiskTake();
+  ok = PutSectors( handle, buf, n, pos );
+  DiskGive();
+
+  return ok;
+}
+
+
+int Rescue( int handle, DWORD i, DWORD volSize )
+{
+  static const char* const what[] =
+  {
+    "reading, skipping past errors",
+    "reading what was skipped",
+    "retrying the bad sectors"
+  };
+  char	  state;
+  DWORD   s, n, skip = 0, done, total;
+  clock_t saved;
+  int	  h, stop = 0;
+
+  if (job->map == NULL)
+  {
+    // A new map, or one for an image being resumed.
+    if (!NewMap( volSize ))
+    {
+      cprintf( "\r\nNot enough memory for the map." );
+      return E_ABORTED;
+    }
+    if (i != 0)
+      MapSet( 0, i, '+' );
+  }
+  // Unread sectors are left as zeros.
+  if (lseek( handle, 0, SEEK_END ) < (off_t)volSize << 11
+      && ftruncate( handle, (off_t)volSize << 11 ))
+  {
+    cprintf( "\r\nUnable to set the size of the image." );
+    return E_ABORTED;
+  }
+
+  putch( '\r' );
+  clreol();
+  saved = ms_clock();
+  for (; job->pass <= (int)retries + 2; ++job->pass, job->pass_pos = 0)
+  {
+    state = (job->pass <= 2) ? '?' : '-';
+    total = MapCount( state );
+    if (total == 0)
+      continue;
+    cprintf( "Pass %d: %s (%s sectors).\r\n", job->pass,
+	     what[(job->pass <= 2) ? job->pass - 1 : 2], thoufmt( total ) );
+    progress( ~0, total );
+    for (done = 0; !stop && MapFind( job->pass_pos, state, &s, &n ); )
+    {
+      progress( (done < total) ? done : total, total );
+      if (state == '-')
+	n = 1;
+      else if (n > job->src.count)
+	n = job->src.count;
+      if (CDReadLong( job->dta, (UINT)n, s ))
+      {
+	if (!WriteSectors( handle, job->dta, (UINT)n, s ))
+	{
+	  stop = 1;
+	  break;
+	}
+	MapSet( s, n, '+' );
+	skip = 0;
+      }
+      else if (state == '?')
+      {
+	MapSet( s, n, '-' );
+	if (job->pass == 1)
+	{
+	  // Leave the sectors after an error for the second pass.
+	  skip = (skip == 0) ? n : (skip >= RESCUE_SKIP / 2) ? RESCUE_SKIP
+							     : skip * 2;
+	  n   += skip;
+	}
+      }
+      done    += n;
+      job->pass_pos = s + n;
+
+      if (ms_clock() - saved >= FIVESECS)
+      {
+	SaveMap();
+	saved = ms_clock();
+      }
+      if (KeyHit())
+	stop = Abort( "Paused", "continue" );
+    }
+    if (stop)
+    {
+      SaveMap();
+      return E_ABORTED;
+    }
+    putch( '\r' );
+    clreol();
+  }
+  SaveMap();
+
+  n = MapCount( '-' ) + MapCount( '?' );
+  if (n != 0)
+  {
+    job->hashing = 0;
+    MapName( job->dta );
+    cprintf( "Unreadable sectors: %s (see \"%s\").\r\n",
+	     thoufmt( n ), job->dta );
+    return E_BAD;
+  }
+
+  // All read, but out of order, so hash what was written.
+  job->ring_start = 0;
+  job->hash_end   = volSize;
+  for (s = 0; job->hashing && s < volSize; s += n)
+  {
+    n = (volSize - s > XFER_MAX) ? XFER_MAX : volSize - s;
+    if (pread( handle, job->dta, n << 11, (off_t)s << 11 )
+	!= (ssize_t)(n << 11))
+    {
+      cprintf( "Unable to read the image (to hash it).\r\n" );
+      job->hashing = 0;
+    }
+    for (h = 0; job->hashing && h < HASHERS; ++h)
+      HashSectors( h, job->dta, (UINT)n, s );
+  }
+
+  return E_OK;
+}
+
+
+/*
+ * The manifest is a text file with the name of the (first) image plus ".sum":
+ *
+ *	OMI manifest 1
+ *	Sectors: <number of sectors>
+ *	Image: <first sector> <file name>	(each image of a DVD)
+ *	CRC-32: <crc>
+ *	MD5: <digest>
+ *	SHA-256: <digest>
+ *	Chunk: 2048
+ *	<first sector> <SHA-256 of the chunk>	(each chunk)
+ *
+ * The hashes are of the disc (as if it were a single image).
+ */
+
+void ManifestName( char* name )
+{
+  if (DVD)
+    PartName( 0 );
+  strcpy( name, job->CacheName );
+  strcat( name, ".sum" );
+}
+
+
+int WriteManifest( void )
+{
+  FILE* f;
+  char	name[sizeof(job->CacheName) + 4], hex[SHA256_SIZE * 2 + 1];
+  BYTE	digest[SHA256_SIZE];
+  char* full;
+  DWORD s;
+  int	p;
+
+  ManifestName( name );
+  f = fopen( name, "w" );
+  if (f == NULL)
+  {
+    fprintf( stderr, "ERROR: \"%s\" could not be created.\n", name );
+    return 0;
+  }
+
+  fprintf( f, "OMI manifest %d\n", MANIFEST_VERSION );
+  fprintf( f, "Sectors: %u\n", job->sectors );
+  if (DVD)
+  {
+    for (p = 0, s = 0; s < job->sectors; ++p, s += IMG_SIZE)
+    {
+      PartName( p );
+      // A file in another directory is named in full.
+      if (part_dirs && p % part_dirs)
+      {
+	full = realpath( job->CacheName, NULL );
+	fprintf( f, "Image: %u %s\n", s, (full) ? full : job->CacheName );
+	free( full );
+      }
+      else
+	fprintf( f, "Image: %u %s\n", s, BaseName( job->CacheName ) );
+    }
+  }
+  else
+    fprintf( f, "Image: 0 %s\n", BaseName( job->CacheName ) );
+  fprintf( f, "CRC-32: %08x\n", job->hash_crc );
+  Md5Final( &job->hash_md5, digest );
+  fprintf( f, "MD5: %s\n", HashHex( hex, digest, MD5_SIZE ) );
+  Sha256Final( &job->hash_sha, digest );
+  fprintf( f, "SHA-256: %s\n", HashHex( hex, digest, SHA256_SIZE ) );
+  fprintf( f, "Chunk: %u\n", HASH_CHUNK );
+  for (s = 0; s < job->sectors; s += HASH_CHUNK)
+    fprintf( f, "%u %s\n", s, HashHex( hex, job->chunk_sum + s / HASH_CHUNK
+						    * SHA256_SIZE,
+					  SHA256_SIZE ) );
+  if (fclose( f ) != 0)
+  {
+    fprintf( stderr, "ERROR: \"%s\" could not be written.\n", name );
+    return 0;
+  }
+
+  return 1;
+}
+
+
+/*
+ * Verify reads the disc (or the image) a chunk at a time, in order, handing
+ * each chunk to a thread to hash and compare with the manifest, so as many
+ * chunks are checked at once as there are processors.
+ */
+
+struct
+{
+  char* buf;
+  DWORD sector; 	// first sector of the chunk
+  UINT	count;
+  int	busy;
+} check[VERIFIERS];
+
+BYTE* chunk_bad;
+int   image_fd[26];
+DWORD image_start[26];
+int   images;
+
+
+void* Verifier( void* arg )
+{
+  struct sha256 h;
+  BYTE	digest[SHA256_SIZE];
+  int	busy, w = ((struct helper*)arg)->n;
+  DWORD c;
+
+  job = ((struct helper*)arg)->job;
+  for (;;)
+  {
+    pthread_mutex_lock( &job->ring_lock );
+    while (!check[w].busy && !job->ring_quit)
+      pthread_cond_wait( &job->ring_change, &job->ring_lock );
+    busy = check[w].busy;
+    pthread_mutex_unlock( &job->ring_lock );
+    if (!busy)
+      break;
+
+    c = check[w].sector / HASH_CHUNK;
+    Sha256Init( &h );
+    Sha256Update( &h, check[w].buf, check[w].count << 11 );
+    Sha256Final( &h, digest );
+    if (memcmp( digest, job->chunk_sum + c * SHA256_SIZE, SHA256_SIZE ) != 0)
+      chunk_bad[c] = 1;
+
+    pthread_mutex_lock( &job->ring_lock );
+    check[w].busy = 0;
+    pthread_cond_broadcast( &job->ring_change );
+    pthread_mutex_unlock( &job->ring_lock );
+  }
+
+  return NULL;
+}
+
+
+// Read n sectors from the disc or the image; a chunk is never split between
+// images, since they're a whole number of chunks.
+int VerifyRead( int disc, char* buf, UINT n, DWORD sector )
+{
+  UINT	part;
+  int	f;
+
+  for (; n; n -= part, sector += part, buf += part << 11)
+  {
+    part = n;
+    if (disc && part > job->src.count)
+      part = job->src.count;
+    for (f = images; --f > 0 && image_start[f] > sector;) ;
+    while (!((disc) ? CDReadLong( buf, part, sector )
+		    : pread( image_fd[f], buf, part << 11,
+			     (off_t)(sector - image_start[f]) << 11 )
+		      == (ssize_t)(part << 11)))
+    {
+      if (Abort( "Read error", "try again" ))
+	return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+int Verify( int disc )
+{
+  FILE* f;
+  char	name[sizeof(job->CacheName) + 4], line[sizeof(job->CacheName) + 40];
+  char	file[sizeof(job->CacheName)], hex[SHA256_SIZE * 2 + 1], *base;
+  char	path[sizeof(job->CacheName) + 4];
+  pthread_t thread[VERIFIERS];
+  struct helper helper[VERIFIERS];
+  DWORD s, c, bad, chunks = 0, vsectors = 0;
+  UINT	n, chunk = 0;
+  int	w, workers, rc = E_VERIFY;
+
+  ManifestName( name );
+  f = fopen( name, "r" );
+  if (f == NULL)
+  {
+    fprintf( stderr, "ERROR: \"%s\" could not be opened.\n", name );
+    return E_VERIFY;
+  }
+  base = strrchr( name, '/' );
+  base = (base == NULL) ? name : base + 1;
+  images = 0;
+  if (fgets( line, sizeof(line), f ) == NULL
+      || sscanf( line, "OMI manifest %d", &w ) != 1 || w != MANIFEST_VERSION)
+    goto bad_manifest;
+  while (fgets( line, sizeof(line), f ) != NULL)
+  {
+    if (sscanf( line, "Sectors: %u", &s ) == 1)
+    {
+      vsectors	= s;
+      chunks	= (vsectors + HASH_CHUNK - 1) / HASH_CHUNK;
+      job->chunk_sum = calloc( chunks + 1, SHA256_SIZE + 1 );
+      if (job->chunk_sum == NULL)
+      {
+	fputs( "ERROR: Not enough memory.\n", stderr );
+	return E_MEM;
+      }
+      chunk_bad = job->chunk_sum + (chunks + 1) * SHA256_SIZE;
+      memset( chunk_bad, 1, chunks );	// until its hash is found
+    }
+    else if (sscanf( line, "Chunk: %u", &chunk ) == 1)
+    {
+      if (chunk != HASH_CHUNK)
+	goto bad_manifest;
+    }
+    else if (sscanf( line, "Image: %u %259[^\n]", &s, file ) == 2)
+    {
+      w = (*file == '/') ? 0 : (int)(base - name);
+      if (images == 26 || (images == 0) != (s == 0)
+	  || w + strlen( file ) >= sizeof(path))
+	goto bad_manifest;
+      image_start[images] = s;
+      // The image is where the manifest is, unless it's named in full.
+      memcpy( path, name, w );
+      strcpy( path + w, file );
+      image_fd[images] = (disc) ? -1 : open( path, O_RDONLY );
+      if (!disc && image_fd[images] == -1)
+      {
+	fprintf( stderr, "ERROR: \"%s\" could not be opened.\n", path );
+	return E_VERIFY;
+      }
+      ++images;
+    }
+    else if (sscanf( line, "%u %64s", &s, hex ) == 2 && job->chunk_sum != NULL
+	     && s < vsectors && s % HASH_CHUNK == 0 && strlen( hex ) == 64)
+    {
+      c = s / HASH_CHUNK;
+      for (w = 0; w < SHA256_SIZE; ++w)
+	sscanf( hex + w * 2, "%2hhx", job->chunk_sum + c * SHA256_SIZE + w );
+      chunk_bad[c] = 0;
+    }
+  }
+  fclose( f );
+  if (job->chunk_sum == NULL || images == 0 || memchr( chunk_bad, 1, chunks ))
+  {
+  bad_manifest:
+    ManifestName( name );
+    fprintf( stderr, "ERROR: \"%s\" is not a manifest.\n", name );
+    return E_VERIFY;
+  }
+  if (!disc && pread( image_fd[0], line, 4, 0 ) == 4
+      && memcmp( line, CDZ_SIG, 4 ) == 0)
+  {
+    fputs( "ERROR: A packed image can only be checked against the disc.\n",
+	   stderr );
+    return E_VERIFY;
+  }
+  job->sectors = vsectors;
+
+  workers = (int)sysconf( _SC_NPROCESSORS_ONLN );
+  if (workers < 1)
+    workers = 1;
+  else if (workers > VERIFIERS)
+    workers = VERIFIERS;
+  job->ring_quit = 0;
+  for (w = 0; w < workers; ++w)
+  {
+    check[w].buf	= malloc( HASH_CHUNK << 11 );
+    check[w].busy = 0;
+    helper[w].job = job;
+    helper[w].n   = w;
+    if (check[w].buf == NULL
+	|| pthread_create( &thread[w], NULL, Verifier, &helper[w] ))
+      break;
+  }
+  if (w == 0)
+  {
+    fputs( "ERROR: Not enough memory.\n", stderr );
+    return E_MEM;
+  }
+  workers = w;
+
+  ManifestName( name );
+  printf( "Checking %s against \"%s\".\n", (disc) ? job->CDName : "the image",
+	  name );
+  _setcursortype( _NOCURSOR );
+  progress( ~0, job->sectors );
+  for (s = 0; s < job->sectors; s += n)
+  {
+    progress( s, job->sectors );
+
+    pthread_mutex_lock( &job->ring_lock );
+    for (;;)
+    {
+      for (w = 0; w < workers && check[w].busy; ++w) ;
+      if (w < workers)
+	break;
+      pthread_cond_wait( &job->ring_change, &job->ring_lock );
+    }
+    pthread_mutex_unlock( &job->ring_lock );
+
+    n = (job->sectors - s > HASH_CHUNK) ? HASH_CHUNK
+					  : (UINT)(job->sectors - s);
+    if (!VerifyRead( disc, check[w].buf, n, s ))
+      break;
+    check[w].sector = s;
+    check[w].count  = n;
+    pthread_mutex_lock( &job->ring_lock );
+    check[w].busy = 1;
+    pthread_cond_broadcast( &job->ring_change );
+    pthread_mutex_unlock( &job->ring_lock );
+
+    if (KeyHit())
+    {
+      if (Abort( "Paused", "continue" ))
+	break;
+    }
+  }
+
+  // Let the threads finish what they're doing, then stop them.
+  pthread_mutex_lock( &job->ring_lock );
+  for (w = 0; w < workers;)
+  {
+    if (check[w].busy)
+      pthread_cond_wait( &job->ring_change, &job->ring_lock );
+    else
+      ++w;
+  }
+  job->ring_quit = 1;
+  pthread_cond_broadcast( &job->ring_change );
+  pthread_mutex_unlock( &job->ring_lock );
+  for (w = 0; w < workers; ++w)
+    pthread_join( thread[w], NULL );
+
+  if (s < job->sectors)
+  {
+    cputs( "\r\n" );
+    rc = E_ABORTED;
+  }
+  else
+  {
+    putch( '\r' );
+    clreol();
+    for (bad = c = 0; c < chunks; ++c)
+    {
+      if (!chunk_bad[c])
+	continue;
+      ++bad;
+      cprintf( "Sectors %s", thoufmt( c * HASH_CHUNK ) );
+      s = (c + 1) * HASH_CHUNK;
+      cprintf( " to %s don't match.\r\n",
+	       thoufmt( ((s > job->sectors) ? job->sectors : s) - 1 ) );
+    }
+    if (bad == 0)
+    {
+      cprintf( "All %s sectors match.\r\n", thoufmt( job->sectors ) );
+      rc = E_OK;
+    }
+  }
+  _setcursortype( _NORMALCURSOR );
+
+  return rc;
+}
+
+
+/*
+ * Several drives are imaged at once as jobs, each in its own thread (with its
+ * own reader and hashers), whilst the main thread draws them all and looks
+ * after the keyboard.  A job's output is captured as its status line.  It
+ * can't ask about an error, so a read or write error stops it (rescue mode
+ * doesn't ask anyway).  Jobs writing to the same disk take turns, each
+ * writing all it has read before another, so the disk isn't seeking between
+ * images for every buffer.
+ */
+
+struct
+{
+  dev_t dev;
+  pthread_mutex_t lock;
+} disk[JOBS];
+int   disks;
+
+
+void InitJob( char* name )
+{
+  job->CDName     = name;
+  job->CDfmt      = CD_Unknown;
+  job->ring_image = -1;
+  pthread_mutex_init( &job->ring_lock, NULL );
+  pthread_cond_init( &job->ring_change, NULL );
+}
+
+
+void AddSource( char* name )
+{
+  if (jobs == JOBS)
+  {
+    fprintf( stderr, "ERROR: No more than %d drives at once.\n", JOBS );
+    exit( E_NOCD );
+  }
+  source[jobs++] = name;
+}
+
+
+int KeyHit( void )
+{
+  int stop;
+
+  if (!in_job)
+    return kbhit();
+
+  pthread_mutex_lock( &show_lock );
+  stop = stop_jobs;
+  pthread_mutex_unlock( &show_lock );
+
+  return stop;
+}
+
+
+void DiskTake( void )
+{
+  if (in_job)
+    pthread_mutex_lock( &disk[job->disk].lock );
+}
+
+
+void DiskGive( void )
+{
+  if (in_job)
+    pthread_mutex_unlock( &disk[job->disk].lock );
+}
+
+
+// Find the disk the image is written to.
+int ImageDisk( void )
+{
+  char	dir[sizeof(job->CacheName)];
+  char* slash;
+  struct stat st;
+  int	d;
+
+  strcpy( dir, job->CacheName );
+  slash = strrchr( dir, '/' );
+  if (slash == NULL)
+    strcpy( dir, "." );
+  else
+    slash[1] = '\0';
+  if (stat( dir, &st ) != 0)
+    st.st_dev = 0;
+  for (d = 0; d < disks && disk[d].dev != st.st_dev; ++d) ;
+  if (d == disks)
+  {
+    disk[d].dev = st.st_dev;
+    pthread_mutex_init( &disk[d].lock, NULL );
+    ++disks;
+  }
+
+  return d;
+}
+
+
+void* ImageJob( void* arg )
+{
+  int rc;
+
+  job	 = arg;
+  in_job = 1;
+  ttycapture( job->status, sizeof(job->status) );
+  rc = ImageDisc();
+
+  pthread_mutex_lock( &show_lock );
+  job->rc   = rc;
+  job->done = 1;
+  pthread_mutex_unlock( &show_lock );
+
+  return NULL;
+}
+
+
+// Draw two lines for each job: the drive and its status, then its progress
+// (or how it finished).  To redraw, move back up over the previous lot.
+void ShowJobs( int redraw )
+{
+  static const char* const result[] =
+  {
+    "Done.",
+    "Not enough memory.",
+    "No disc.",
+    "Image already exists.",
+    "Image could not be created.",
+    "Stopped.",
+    "",
+    "Imaged, but some sectors couldn't be read."
+  };
+  char	status[sizeof(job->status)], line[160];
+  DWORD cur, max;
+  int	n, stage, done, rc;
+
+  if (redraw)
+    gotoxy( 1, wherey() - 2 * jobs );
+  for (n = 0; n < jobs; ++n)
+  {
+    job = &job_list[n];
+    pthread_mutex_lock( &show_lock );
+    cur   = job->cur;
+    max   = job->max;
+    stage = job->stage;
+    done  = job->done;
+    rc	  = job->rc;
+    pthread_mutex_unlock( &show_lock );
+
+    ttycopy( status, job->status, sizeof(status) );
+    snprintf( line, sizeof(line), "%s: %s", job->CDName, status );
+    line[79] = '\0';
+    cputs( line );
+    clreol();
+    cputs( "\r\n" );
+
+    if (done)
+    {
+      if (job->shown != -1)
+      {
+	clreol();
+	cputs( result[rc] );
+	job->shown = -1;
+      }
+    }
+    else
+    {
+      if (stage != job->shown)
+      {
+	clreol();
+	progress( ~0, max );
+	job->shown = stage;
+	job->drawn = ~0;
+      }
+      // Only draw what's changed, which also keeps the rate sensible.
+      if (cur != ~0 && cur != job->drawn)
+      {
+	progress( cur, max );
+	job->drawn = cur;
+      }
+    }
+    cputs( "\r\n" );
+  }
+}
+
+
+int ImageJobs( void )
+{
+  pthread_t thread[JOBS];
+  struct timespec tick = { 0, 200000000 };	// redraw five times a second
+  char	dir[sizeof(job->CacheName)], name[sizeof(job->CacheName) + 4];
+  char* image[JOBS];
+  DWORD size[JOBS], given, need;
+  int	n, m, running, rc;
+
+  // The name given is where the images go.
+  strcpy( dir, job->CacheName );
+  if (*dir)
+  {
+    struct stat st;
+    if (stat( dir, &st ) != 0 || !S_ISDIR( st.st_mode ))
+    {
+      fprintf( stderr, "ERROR: \"%s\" is not a directory (several drives "
+		       "are named from their labels).\n", dir );
+      return E_CREATE;
+    }
+    image_dir = dir;
+  }
+  given = job->sectors;
+
+  for (n = 0; n < jobs; ++n)
+  {
+    job = &job_list[n];
+    *job->CacheName = '\0';
+    job->sectors    = given;
+    rc = Prepare();
+    if (rc != E_OK)
+      return rc;
+
+    for (m = 0; m < n; ++m)
+    {
+      if (strcmp( job->CacheName, image[m] ) == 0)
+      {
+	fprintf( stderr, "ERROR: %s and %s would both be imaged to \"%s\".\n",
+			 source[m], job->CDName, job->CacheName );
+	return E_CREATE;
+      }
+    }
+    image[n] = job->CacheName;
+    size[n]  = job->sectors;
+    // Nothing can be asked once they're going, so don't overwrite.
+    if (DVD)
+      PartName( 0 );
+    MapName( name );
+    if (access( job->CacheName, 0 ) == 0
+	&& !(rescue && access( name, 0 ) == 0))
+    {
+      fprintf( stderr, "ERROR: \"%s\" already exists (image it by itself to "
+		       "overwrite or resume).\n", job->CacheName );
+      return E_EXISTS;
+    }
+
+    // Images on the same disk need room for them all.
+    job->disk = ImageDisk();
+    if (!packed)
+    {
+      for (need = 0, m = 0; m <= n; ++m)
+      {
+	if (job_list[m].disk == job->disk)
+	  need += size[m];
+      }
+      CheckFreeSpace( need );
+    }
+    GetFTime();
+  }
+
+  _setcursortype( _NOCURSOR );
+  ShowJobs( 0 );
+  for (n = 0; n < jobs; ++n)
+  {
+    if (pthread_create( &thread[n], NULL, ImageJob, &job_list[n] ))
+    {
+      job_list[n].rc   = E_MEM;
+      job_list[n].done = 2;	// never started
+    }
+  }
+
+  do
+  {
+    nanosleep( &tick, NULL );
+    pthread_mutex_lock( &show_lock );
+    for (running = n = 0; n < jobs; ++n)
+      running += !job_list[n].done;
+    pthread_mutex_unlock( &show_lock );
+    ShowJobs( 1 );
+    if (running && kbhit())
+    {
+      // The jobs carry on whilst asking.
+      m = Abort( "Stop", "continue" );
+      if (m)
+      {
+	putch( '\r' );
+	clreol();
+	gotoxy( 1, wherey() - 1 );
+	pthread_mutex_lock( &show_lock );
+	stop_jobs = 1;
+	pthread_mutex_unlock( &show_lock );
+      }
+    }
+  } while (running);
+  _setcursortype( _NORMALCURSOR );
+
+  rc = E_OK;
+  for (n = 0; n < jobs; ++n)
+  {
+    if (job_list[n].done != 2)
+      pthread_join( thread[n], NULL );
+    if (rc == E_OK)
+      rc = job_list[n].rc;
+  }
+
+  return rc;
+}
+
+
+void setftime( int handle, time_t* t )
+{
+  struct timespec ts[2];
+
+  ts[0].tv_sec	= ts[1].tv_sec	= *t;
+  ts[0].tv_nsec = ts[1].tv_nsec = 0;
+  futimens( handle, ts );
+}
+
+
+clock_t ms_clock( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (clock_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+#endif
@@ -0,0 +1,211 @@
+/*
+ * ttyconio.c: Borland-style console functions for POSIX terminals.
+ *
+ * The terminal is switched to non-canonical mode (no echo) the first time a
+ * key is requested and restored at exit. If standard input is not a terminal,
+ * kbhit() never sees a key and getch() returns ESC, so prompts abort rather
+ * than wait forever.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <pthread.h>
+#include "ttyconio.h"
+
+#define HOME_Y 1000		// the line wherey() always returns
+
+static struct termios old_tio;
+static int raw = -1;		// -1 not tested, 0 not a tty, 1 raw mode
+
+static __thread char* cap_buf;	// the line being captured (ttycapture)
+static __thread int   cap_size, cap_len, cap_new;
+static pthread_mutex_t cap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void restore_tty( void )
+{
+  if (raw == 1)
+    tcsetattr( STDIN_FILENO, TCSANOW, &old_tio );
+  _setcursortype( _NORMALCURSOR );	// in case we exit whilst hidden
+}
+
+
+static int raw_tty( void )
+{
+  struct termios tio;
+
+  if (raw == -1)
+  {
+    raw = 0;
+    if (isatty( STDIN_FILENO ) && tcgetattr( STDIN_FILENO, &old_tio ) == 0)
+    {
+      tio = old_tio;
+      tio.c_lflag &= ~(ICANON | ECHO);
+      tio.c_cc[VMIN]  = 1;
+      tio.c_cc[VTIME] = 0;
+      if (tcsetattr( STDIN_FILENO, TCSANOW, &tio ) == 0)
+	raw = 1;
+    }
+    atexit( restore_tty );
+  }
+  return raw;
+}
+
+
+// Keep the last line of s; a line ends at CR or LF, so the next text
+// replaces it.
+static void capture( const char* s )
+{
+  pthread_mutex_lock( &cap_lock );
+  for (; *s; ++s)
+  {
+    if (*s == '\r' || *s == '\n')
+      cap_new = 1;
+    else
+    {
+      if (cap_new)
+      {
+	cap_len = 0;
+	cap_new = 0;
+      }
+      if (cap_len < cap_size - 1)
+	cap_buf[cap_len++] = *s;
+    }
+  }
+  cap_buf[cap_len] = '\0';
+  pthread_mutex_unlock( &cap_lock );
+}
+
+
+void ttycapture( char* buf, int size )
+{
+  cap_buf  = buf;
+  cap_size = size;
+  cap_len  = 0;
+  cap_new  = 0;
+  if (buf != NULL)
+    *buf = '\0';
+}
+
+
+void ttycopy( char* dst, const char* buf, int size )
+{
+  pthread_mutex_lock( &cap_lock );
+  snprintf( dst, size, "%s", buf );
+  pthread_mutex_unlock( &cap_lock );
+}
+
+
+int kbhit( void )
+{
+  struct pollfd pfd;
+
+  if (!raw_tty())
+    return 0;
+  fflush( stdout );
+  pfd.fd     = STDIN_FILENO;
+  pfd.events = POLLIN;
+  return (poll( &pfd, 1, 0 ) == 1);
+}
+
+
+int getch( void )
+{
+  unsigned char c;
+
+  fflush( stdout );
+  if (!raw_tty() || read( STDIN_FILENO, &c, 1 ) != 1)
+    return 27;
+  return c;
+}
+
+
+int putch( int c )
+{
+  char s[2];
+
+  if (cap_buf != NULL)
+  {
+    s[0] = (char)c;
+    s[1] = '\0';
+    capture( s );
+    return c;
+  }
+  putchar( c );
+  fflush( stdout );
+  return c;
+}
+
+
+int cputs( const char* s )
+{
+  if (cap_buf != NULL)
+  {
+    capture( s );
+    return 0;
+  }
+  fputs( s, stdout );
+  fflush( stdout );
+  return 0;
+}
+
+
+int cprintf( const char* fmt, ... )
+{
+  va_list args;
+  int	  len;
+  char	  line[256];
+
+  va_start( args, fmt );
+  if (cap_buf != NULL)
+  {
+    len = vsnprintf( line, sizeof(line), fmt, args );
+    capture( line );
+  }
+  else
+  {
+    len = vprintf( fmt, args );
+    fflush( stdout );
+  }
+  va_end( args );
+  return len;
+}
+
+
+void clreol( void )
+{
+  if (cap_buf == NULL)
+    fputs( "\33[K", stdout );
+}
+
+
+void gotoxy( int x, int y )
+{
+  if (cap_buf != NULL)
+    return;
+  if (y < HOME_Y)
+    printf( "\33[%dA", HOME_Y - y );
+  putchar( '\r' );
+  if (x > 1)
+    printf( "\33[%dC", x - 1 );
+}
+
+
+int wherey( void )
+{
+  return HOME_Y;
+}
+
+
+void _setcursortype( int type )
+{
+  if (cap_buf != NULL)
+    return;
+  if (isatty( STDOUT_FILENO ))
+    fputs( (type == _NOCURSOR) ? "\33[?25l" : "\33[?25h", stdout );
+  fflush( stdout );
+}
@@ -0,0 +1,32 @@
+/*
+ * ttyconio.h: Borland-style console functions for POSIX terminals.
+ *
+ * Only what OMI uses is provided. Cursor positioning is relative: wherey()
+ * always returns the same line, so gotoxy( x, wherey() ) positions on the
+ * current line and gotoxy( x, wherey() - n ) moves up n lines.
+ *
+ * A thread that calls ttycapture() has its output kept in the buffer (just
+ * the line last written) rather than going to the terminal, and positioning
+ * does nothing; another thread reads the buffer with ttycopy().
+ */
+
+#ifndef TTYCONIO_H
+#define TTYCONIO_H
+
+#define _NOCURSOR     0
+#define _NORMALCURSOR 2
+
+int  getch( void );
+int  kbhit( void );
+int  putch( int c );
+int  cputs( const char* s );
+int  cprintf( const char* fmt, ... );
+void clreol( void );
+void gotoxy( int x, int y );
+int  wherey( void );
+void _setcursortype( int type );
+
+void ttycapture( char* buf, int size );
+void ttycopy( char* dst, const char* buf, int size );
+
+#endif
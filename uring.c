@@ -0,0 +1,236 @@
+/*
+ * uring.c: Asynchronous reads and writes for the POSIX version of OMI.
+ *
+ * The rings are shared with the kernel: we fill in a submission entry and
+ * advance the tail, the kernel advances the completion tail as requests
+ * finish and we advance its head as we collect them.  Only the tails the
+ * other side writes need the acquire/release ordering.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "uring.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define load_acquire( p )     __atomic_load_n( p, __ATOMIC_ACQUIRE )
+#define store_release( p, v ) __atomic_store_n( p, v, __ATOMIC_RELEASE )
+
+
+int UringInit( struct uring* u, unsigned entries )
+{
+  struct io_uring_params p;
+  char*  sq, *cq;
+
+  memset( u, 0, sizeof(*u) );
+  memset( &p, 0, sizeof(p) );
+  u->fd = (int)syscall( __NR_io_uring_setup, entries, &p );
+  if (u->fd < 0)
+    return 0;
+  u->entries = p.sq_entries;
+
+  u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (u->cq_size > u->sq_size)
+      u->sq_size = u->cq_size;
+    u->cq_size = 0;		// it's the same mapping
+  }
+  u->sq_map = mmap( NULL, u->sq_size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING );
+  if (u->sq_map == MAP_FAILED)
+    goto failed;
+  if (u->cq_size == 0)
+    u->cq_map = u->sq_map;
+  else
+  {
+    u->cq_map = mmap( NULL, u->cq_size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING );
+    if (u->cq_map == MAP_FAILED)
+      goto failed;
+  }
+  u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = mmap( NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES );
+  if (u->sqes == MAP_FAILED)
+    goto failed;
+
+  sq = u->sq_map;
+  u->sq_head  = (unsigned*)(sq + p.sq_off.head);
+  u->sq_tail  = (unsigned*)(sq + p.sq_off.tail);
+  u->sq_mask  = (unsigned*)(sq + p.sq_off.ring_mask);
+  u->sq_array = (unsigned*)(sq + p.sq_off.array);
+  cq = u->cq_map;
+  u->cq_head  = (unsigned*)(cq + p.cq_off.head);
+  u->cq_tail  = (unsigned*)(cq + p.cq_off.tail);
+  u->cq_mask  = (unsigned*)(cq + p.cq_off.ring_mask);
+  u->cqes     = cq + p.cq_off.cqes;
+
+  return 1;
+
+failed:
+  if (u->sqes != NULL && u->sqes != MAP_FAILED)
+    munmap( u->sqes, u->sqes_size );
+  if (u->cq_size && u->cq_map != NULL && u->cq_map != MAP_FAILED)
+    munmap( u->cq_map, u->cq_size );
+  if (u->sq_map != NULL && u->sq_map != MAP_FAILED)
+    munmap( u->sq_map, u->sq_size );
+  close( u->fd );
+  u->fd = -1;
+  return 0;
+}
+
+
+// Wait for what's still in flight (the buffers must outlive the requests),
+// then close the ring.
+void UringExit( struct uring* u )
+{
+  unsigned long tag;
+  int	res;
+
+  if (u->fd < 0)
+    return;
+  while (u->flight || u->queued)
+  {
+    if (!UringSubmit( u, 1 ))
+      break;
+    while (UringReap( u, &tag, &res )) ;
+  }
+  munmap( u->sqes, u->sqes_size );
+  if (u->cq_size)
+    munmap( u->cq_map, u->cq_size );
+  munmap( u->sq_map, u->sq_size );
+  close( u->fd );
+  u->fd = -1;
+}
+
+
+static int queue( struct uring* u, int op, int fd, const void* buf,
+		  unsigned len, off_t ofs, unsigned long tag )
+{
+  struct io_uring_sqe* sqe;
+  unsigned tail = *u->sq_tail, idx;
+
+  if (tail - load_acquire( u->sq_head ) == u->entries)
+    return 0;
+  idx = tail & *u->sq_mask;
+  sqe = (struct io_uring_sqe*)u->sqes + idx;
+  memset( sqe, 0, sizeof(*sqe) );
+  sqe->opcode	 = (unsigned char)op;
+  sqe->fd	 = fd;
+  sqe->addr	 = (unsigned long)buf;
+  sqe->len	 = len;
+  sqe->off	 = ofs;
+  sqe->user_data = tag;
+  u->sq_array[idx] = idx;
+  store_release( u->sq_tail, tail + 1 );
+  ++u->queued;
+
+  return 1;
+}
+
+
+int UringRead( struct uring* u, int fd, void* buf, unsigned len, off_t ofs,
+	       unsigned long tag )
+{
+  return queue( u, IORING_OP_READ, fd, buf, len, ofs, tag );
+}
+
+
+int UringWrite( struct uring* u, int fd, const void* buf, unsigned len,
+		off_t ofs, unsigned long tag )
+{
+  return queue( u, IORING_OP_WRITE, fd, buf, len, ofs, tag );
+}
+
+
+// Submit what's queued and wait until at least wait requests have finished
+// (including any finished earlier and not yet collected).
+int UringSubmit( struct uring* u, unsigned wait )
+{
+  int n;
+
+  if (u->fd < 0)
+    return 0;
+  if (wait > u->flight + u->queued)
+    wait = u->flight + u->queued;
+  for (;;)
+  {
+    n = (int)syscall( __NR_io_uring_enter, u->fd, u->queued, wait,
+		      (wait) ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+    if (n >= 0)
+      break;
+    if (errno != EINTR)
+      return 0;
+  }
+  u->queued -= n;
+  u->flight += n;
+
+  return 1;
+}
+
+
+// Collect a finished request: its tag and result (bytes or -errno).
+int UringReap( struct uring* u, unsigned long* tag, int* res )
+{
+  struct io_uring_cqe* cqe;
+  unsigned head;
+
+  if (u->fd < 0)
+    return 0;
+  head = *u->cq_head;
+  if (head == load_acquire( u->cq_tail ))
+    return 0;
+  cqe  = (struct io_uring_cqe*)u->cqes + (head & *u->cq_mask);
+  *tag = (unsigned long)cqe->user_data;
+  *res = cqe->res;
+  store_release( u->cq_head, head + 1 );
+  --u->flight;
+
+  return 1;
+}
+
+
+#else
+
+int UringInit( struct uring* u, unsigned entries )
+{
+  (void)entries;
+  u->fd = -1;
+  return 0;
+}
+
+void UringExit( struct uring* u ) { (void)u; }
+
+int UringRead( struct uring* u, int fd, void* buf, unsigned len, off_t ofs,
+	       unsigned long tag )
+{
+  (void)u; (void)fd; (void)buf; (void)len; (void)ofs; (void)tag;
+  return 0;
+}
+
+int UringWrite( struct uring* u, int fd, const void* buf, unsigned len,
+		off_t ofs, unsigned long tag )
+{
+  (void)u; (void)fd; (void)buf; (void)len; (void)ofs; (void)tag;
+  return 0;
+}
+
+int UringSubmit( struct uring* u, unsigned wait )
+{
+  (void)u; (void)wait;
+  return 0;
+}
+
+int UringReap( struct uring* u, unsigned long* tag, int* res )
+{
+  (void)u; (void)tag; (void)res;
+  return 0;
+}
+
+#endif
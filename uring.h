@@ -0,0 +1,46 @@
+/*
+ * uring.h: Asynchronous reads and writes for the POSIX version of OMI.
+ *
+ * A thin layer over the io_uring system calls (no liburing): requests are
+ * queued, submitted together and their completions collected in whatever
+ * order they finish, each identified by the tag it was queued with.  Each
+ * ring is only ever used by one thread.  Elsewhere than Linux (or when the
+ * kernel doesn't allow it) UringInit() fails and the caller does without.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <sys/types.h>
+
+struct uring
+{
+  int	    fd;
+  unsigned  entries;
+  unsigned  queued;		// requests not yet submitted
+  unsigned  flight;		// requests submitted, not yet collected
+
+  // Submission queue
+  void*     sq_map;
+  size_t    sq_size;
+  unsigned* sq_head, *sq_tail, *sq_mask, *sq_array;
+  void*     sqes;
+  size_t    sqes_size;
+
+  // Completion queue
+  void*     cq_map;
+  size_t    cq_size;
+  unsigned* cq_head, *cq_tail, *cq_mask;
+  void*     cqes;
+};
+
+int  UringInit( struct uring* u, unsigned entries );
+void UringExit( struct uring* u );
+int  UringRead( struct uring* u, int fd, void* buf, unsigned len, off_t ofs,
+		unsigned long tag );
+int  UringWrite( struct uring* u, int fd, const void* buf, unsigned len,
+		 off_t ofs, unsigned long tag );
+int  UringSubmit( struct uring* u, unsigned wait );
+int  UringReap( struct uring* u, unsigned long* tag, int* res );
+
+#endif
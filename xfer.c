@@ -0,0 +1,317 @@
+/*
+ * xfer.c: Read a CD/DVD source for the POSIX versions of OMI and ISOBAR.
+ *
+ * A block device starts with the 64Ki the DOS versions use, limited to what
+ * the driver will accept in one request; an image file starts at 256Ki; a
+ * pipe at 64Ki (its usual buffer size). Every XFER_WINDOW bytes the rate is
+ * compared with the best so far: if it improved the count is doubled,
+ * otherwise the best count is kept from then on.
+ *
+ * A pipe can only be read forwards, so its first XFER_HEAD sectors (which
+ * cover the volume descriptors) and the last sector read are remembered;
+ * any other backwards read fails.
+ *
+ * XferCopy writes part of an image file to another file without reading it
+ * into a buffer: the blocks are shared if the file system can (reflink),
+ * otherwise the kernel copies them (copy_file_range), otherwise the source
+ * is mapped and written straight from the page cache.  Only Linux has the
+ * first two, or a way to ask the driver for its largest request; elsewhere
+ * a device uses XFER_MAX.
+ */
+
+#define _GNU_SOURCE		// copy_file_range
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#include "xfer.h"
+
+#define XFER_WINDOW (8ull << 20) // bytes to measure the rate over
+#define XFER_GAIN   1.05	 // improvement needed to keep doubling
+
+
+static unsigned long long now( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Read exactly len bytes at ofs (or from the pipe), unless EOF or error.
+static int read_all( struct xfer* x, char* buf, size_t len, off_t ofs )
+{
+  ssize_t r;
+
+  while (len)
+  {
+    r = (x->type == SRC_PIPE) ? read( x->fd, buf, len )
+			      : pread( x->fd, buf, len, ofs );
+    if (r <= 0)
+    {
+      if (r < 0 && errno == EINTR)
+	continue;
+      return 0;
+    }
+    buf += r;
+    ofs += r;
+    len -= r;
+  }
+
+  return 1;
+}
+
+
+// Read from a pipe, which must not go backwards (other than what's kept).
+static int read_pipe( struct xfer* x, char* buf, unsigned count,
+		      unsigned long sector )
+{
+  char	   skip[2048];
+  unsigned n;
+
+  if (sector < XFER_HEAD)
+  {
+    n = XFER_HEAD - sector;
+    if (n > count)
+      n = count;
+    memcpy( buf, x->head + (sector << 11), n << 11 );
+    buf += n << 11, sector += n, count -= n;
+  }
+  if (count && sector == x->last_sector && sector < x->pos)
+  {
+    memcpy( buf, x->last, 2048 );
+    buf += 2048, ++sector, --count;
+  }
+  if (count == 0)
+    return 1;
+  if (sector < x->pos)
+    return 0;
+
+  for (; x->pos < sector; ++x->pos)
+    if (!read_all( x, skip, 2048, 0 ))
+      return 0;
+  if (!read_all( x, buf, (size_t)count << 11, 0 ))
+    return 0;
+  x->pos += count;
+  x->last_sector = sector + count - 1;
+  memcpy( x->last, buf + ((count - 1) << 11), 2048 );
+
+  return 1;
+}
+
+
+static void tune( struct xfer* x )
+{
+  double rate = (double)x->bytes / x->ns;
+
+  if (rate > x->best_rate * XFER_GAIN)
+  {
+    x->best_rate = rate;
+    x->best	 = x->count;
+    if (x->count < x->max)
+      x->count <<= 1;
+    else
+      x->settled = 1;
+  }
+  else
+  {
+    x->count   = x->best;
+    x->settled = 1;
+  }
+  x->bytes = x->ns = 0;
+}
+
+
+int XferOpen( struct xfer* x, const char* name, unsigned count )
+{
+  struct stat st;
+#ifdef __linux__
+  unsigned short max;
+#endif
+
+  memset( x, 0, sizeof(*x) );
+  x->fd = (strcmp( name, "-" ) == 0) ? dup( STDIN_FILENO )
+				     : open( name, O_RDONLY );
+  if (x->fd == -1 || fstat( x->fd, &st ) == -1)
+    return 0;
+
+  x->max = XFER_MAX;
+  if (S_ISBLK( st.st_mode ))
+  {
+    x->type  = SRC_DEVICE;
+    x->count = 32;
+#ifdef __linux__
+    if (ioctl( x->fd, BLKSECTGET, &max ) == 0 && max >= 4)
+    {
+      max >>= 2;		// 512-byte sectors
+      if (max < x->max)
+	x->max = (max < XFER_MIN) ? XFER_MIN : max;
+    }
+#endif
+  }
+  else if (S_ISREG( st.st_mode ))
+  {
+    x->type  = SRC_FILE;
+    x->count = 128;
+  }
+  else
+  {
+    x->type  = SRC_PIPE;
+    x->count = 32;
+    x->head  = malloc( (XFER_HEAD + 1) << 11 );
+    if (x->head == NULL)
+      return 0;
+    x->last = x->head + (XFER_HEAD << 11);
+    x->last_sector = ~0ul;
+    // Whatever is missing is left as zero; reading it will fail, below.
+    memset( x->head, 0, XFER_HEAD << 11 );
+    read_all( x, x->head, XFER_HEAD << 11, 0 );
+    x->pos = XFER_HEAD;
+  }
+#ifdef POSIX_FADV_SEQUENTIAL
+  if (x->type != SRC_PIPE)
+    posix_fadvise( x->fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
+  if (x->count > x->max)
+    x->count = x->max;
+  if (count)
+  {
+    x->count = (count > XFER_MAX) ? XFER_MAX : count;
+    x->fixed = 1;
+  }
+  x->best = x->count;
+
+  return 1;
+}
+
+
+void XferClose( struct xfer* x )
+{
+  if (x->fd != -1)
+    close( x->fd );
+  free( x->head );
+  x->fd = -1;
+  x->head = NULL;
+}
+
+
+int XferRead( struct xfer* x, void* buf, unsigned count, unsigned long sector )
+{
+  unsigned long long start;
+  int ok;
+
+  start = now();
+  if (x->type == SRC_PIPE)
+    ok = read_pipe( x, buf, count, sector );
+  else
+    ok = read_all( x, buf, (size_t)count << 11, (off_t)sector << 11 );
+
+  // Only full-sized requests are a fair measure.
+  if (ok && !x->fixed && !x->settled && count == x->count)
+  {
+    x->ns    += now() - start;
+    x->bytes += (size_t)count << 11;
+    if (x->bytes >= XFER_WINDOW && x->ns)
+      tune( x );
+  }
+
+  return ok;
+}
+
+
+// Copy len bytes from sector to the current position of fd. Returns the
+// number of bytes copied, which is len or a multiple of 2048 short of it
+// (possibly 0), with fd positioned after them.
+long long XferCopy( struct xfer* x, int fd, unsigned long sector,
+		    long long len )
+{
+#ifdef __linux__
+  struct file_clone_range fcr;
+  struct stat st;
+#endif
+  off_t  in, out;
+  long long done;
+  ssize_t r;
+  char*  map;
+  size_t skew;
+
+  if (x->type != SRC_FILE || len <= 0)
+    return 0;
+  in  = (off_t)sector << 11;
+  out = lseek( fd, 0, SEEK_CUR );
+  if (out == -1)
+    return 0;
+  done = 0;
+
+#ifdef __linux__
+  // Share whole blocks; the tail (if any) is copied.
+  if (fstat( fd, &st ) == 0 && st.st_blksize > 0
+      && in % st.st_blksize == 0 && out % st.st_blksize == 0)
+  {
+    fcr.src_fd	    = x->fd;
+    fcr.src_offset  = in;
+    fcr.src_length  = len - len % st.st_blksize;
+    fcr.dest_offset = out;
+    if (fcr.src_length && ioctl( fd, FICLONERANGE, &fcr ) == 0)
+    {
+      done = fcr.src_length;
+      in  += done;
+      lseek( fd, out + done, SEEK_SET );
+    }
+  }
+
+  while (done < len)
+  {
+    r = copy_file_range( x->fd, &in, fd, NULL, len - done, 0 );
+    if (r <= 0)
+      break;
+    done += r;
+  }
+#endif
+
+  if (done < len)
+  {
+    skew = in % sysconf( _SC_PAGESIZE );
+    map  = mmap( NULL, len - done + skew, PROT_READ, MAP_SHARED, x->fd,
+		 in - skew );
+    if (map != MAP_FAILED)
+    {
+      madvise( map, len - done + skew, MADV_SEQUENTIAL );
+      r = len - done;
+      while (done < len)
+      {
+	ssize_t w = write( fd, map + skew + (r - (len - done)), len - done );
+	if (w <= 0)
+	  break;
+	done += w;
+      }
+      munmap( map, r + skew );
+    }
+  }
+
+  if (done < len && (done & 2047))
+  {
+    done &= ~2047ll;
+    lseek( fd, out + done, SEEK_SET );
+  }
+
+  return done;
+}
+
+
+const char* XferType( const struct xfer* x )
+{
+  static const char* type[] = { "device", "file", "pipe" };
+
+  return type[x->type];
+}
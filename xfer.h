@@ -0,0 +1,48 @@
+/*
+ * xfer.h: Read a CD/DVD source for the POSIX versions of OMI and ISOBAR.
+ *
+ * The source may be a block device, an image file or a pipe. The number of
+ * sectors requested at a time starts from a value suited to the type of
+ * source and is then tuned from the measured throughput (doubled for as long
+ * as that makes it faster), unless it was given on the command line.
+ */
+
+#ifndef XFER_H
+#define XFER_H
+
+#define XFER_MIN   16		// 32Ki
+#define XFER_MAX   512		// 1Mi, the most ever requested at once
+#define XFER_HEAD  32		// sectors of a pipe kept for re-reading
+
+enum { SRC_DEVICE, SRC_FILE, SRC_PIPE };
+
+struct xfer
+{
+  int	   fd;
+  int	   type;		// SRC_*
+  unsigned count;		// sectors per request
+  unsigned max; 		// most sectors per request (device limit)
+  int	   fixed;		// count given by the user, don't tune
+
+  // Tuning
+  int	   settled;		// found the best count
+  unsigned best;		// count with the best rate so far
+  double   best_rate;		// bytes per nanosecond
+  unsigned long long bytes, ns; // current measuring window
+
+  // Pipes
+  unsigned long long pos;	// sectors read from the pipe
+  char*    head;		// the first XFER_HEAD sectors
+  char*    last;		// the last sector read
+  unsigned long last_sector;
+};
+
+int	    XferOpen( struct xfer* x, const char* name, unsigned count );
+void	    XferClose( struct xfer* x );
+int	    XferRead( struct xfer* x, void* buf, unsigned count,
+		      unsigned long sector );
+long long   XferCopy( struct xfer* x, int fd, unsigned long sector,
+		      long long len );
+const char* XferType( const struct xfer* x );
+
+#endif